@@ -0,0 +1,76 @@
+#ifndef CALENDAR_H
+#define CALENDAR_H
+#include <Arduino.h>
+
+// Calendrier des nettoyages programmés
+//
+// Le calendrier contient jusqu'à CALENDAR_SLOTS créneaux hebdomadaires
+// (jours de la semaine + heure). Lorsqu'il est vide, le créneau
+// quotidien des paramètres (hour, min) est utilisé. Le paramètre sched
+// active ou désactive l'ensemble des créneaux. L'heure du prochain
+// nettoyage est calculée une seule fois, lors d'une modification du
+// calendrier ou d'un déclenchement, et un unique monostable est armé
+// pour cette échéance (au plus CALENDAR_MAX_WAIT plus tard afin de
+// suivre les corrections d'horloge et les changements d'heure).
+// Un créneau manqué (boucle bloquée, reset, horloge non synchronisée)
+// est rattrapé s'il date de moins de CALENDAR_CATCH_UP secondes.
+// L'heure du dernier déclenchement est conservée en mémoire RTC pour
+// qu'un reset n'entraîne ni oubli ni double déclenchement.
+// Les créneaux sont des heures locales ; plan(), fire() et wait()
+// reçoivent l'heure UTC (wallClock.utc()) et mesurent attentes et
+// retards en UTC, sans saut aux changements d'heure. Un créneau dans
+// l'heure sautée au passage à l'heure d'été est dû au moment du
+// changement, un créneau dans l'heure répétée au retour à l'heure
+// d'hiver à sa première occurrence (localToUtc) : aucun n'est perdu ni
+// exécuté deux fois. getNextRun() et getLastRun() rendent des epoch
+// locaux.
+//
+// Format texte d'un calendrier : "1111100 08:30;0000011 10:00"
+// 7 chiffres du lundi au dimanche puis l'heure, créneaux séparés par ';'
+
+#define CALENDAR_SLOTS     8
+#define CALENDAR_CATCH_UP  900
+#define CALENDAR_MAX_WAIT  3600
+#define CALENDAR_FILE_NAME "calendar.txt"
+// Longueur maximale du texte d'un calendrier
+#define CALENDAR_TEXT_MAX  (CALENDAR_SLOTS * 14)
+// Dernier déclenchement en mémoire RTC utilisateur : blocs 99..100
+// (32..98 sont utilisés par logStore)
+#define CALENDAR_RTC_OFFSET 99
+#define CALENDAR_RTC_MAGIC  0x43414c32
+
+// Jours : bit 0 = dimanche ... bit 6 = samedi (DateTime.weekday)
+#define ALL_DAYS 0x7f
+
+struct CalendarSlot {
+  uint8_t days;
+  uint8_t hour;
+  uint8_t minute;
+};
+
+class Calendar {
+private:
+  CalendarSlot slots[CALENDAR_SLOTS];
+  unsigned count;
+  // Créneau quotidien des paramètres, utilisé si le calendrier est vide
+  boolean enabled;
+  CalendarSlot daily;
+  // Dernier déclenchement (UTC) et prochaine échéance (locale)
+  uint32_t lastRun;
+  uint32_t nextRun;
+  void rtcSave();
+public:
+  Calendar();
+  void begin();
+  void setDaily(boolean enabled, int hour, int minute);
+  unsigned getCount();
+  boolean parse(const char *text, unsigned length);
+  int format(char *buffer, unsigned size);
+  uint32_t next(uint32_t after);
+  void plan(uint32_t now);
+  boolean fire(uint32_t now);
+  unsigned wait(uint32_t now);
+  uint32_t getNextRun();
+  uint32_t getLastRun();
+};
+#endif
@@ -0,0 +1,58 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <PubSubClient.h>
+
+// Gestion non bloquante des connexions WiFi et MQTT
+//
+// update() est appelé à chaque passage dans loop() et ne bloque jamais
+// (hors tentative de connexion TCP, bornée par CONN_SOCKET_TIMEOUT).
+// En cas d'échec, les tentatives de connexion au courtier sont espacées
+// selon un backoff exponentiel avec gigue, entre CONN_BACKOFF_MIN et
+// CONN_BACKOFF_MAX. Pendant ce temps loop() continue de tourner
+// (ordonnanceur, relais, OTA).
+
+// Délais de backoff en ms
+#define CONN_BACKOFF_MIN     500
+#define CONN_BACKOFF_MAX     60000
+// Timeout de la socket MQTT en s
+#define CONN_SOCKET_TIMEOUT  2
+// Redémarrage si le WiFi reste absent plus longtemps (ms)
+#define WIFI_RESTART_TIMEOUT 600000UL
+
+// États
+#define C_WIFI_WAIT 0
+#define C_BACKOFF   1
+#define C_CONNECTED 2
+
+class Connection {
+private:
+  PubSubClient* client;
+  const char* user;
+  const char* password;
+  void (*onConnect)(void);
+  char clientId[24];
+  unsigned state;
+  boolean everConnected;
+  unsigned long backoff;
+  unsigned long nextAttempt;
+  unsigned long offlineSince;
+  unsigned long wifiLostSince;
+  // Métriques
+  unsigned reconnectCount;
+  unsigned long offlineTime;
+  unsigned long lastReconnectTime;
+  void disconnected(unsigned long now);
+  void connected(unsigned long now);
+public:
+  Connection();
+  void begin(PubSubClient& client, const char* user, const char* password, void (*onConnect)(void));
+  void update();
+  boolean isConnected();
+  unsigned getState();
+  unsigned getReconnectCount();
+  unsigned long getOfflineTime();
+  unsigned long getLastReconnectTime();
+};
+#endif
@@ -1,7 +1,12 @@
 #ifndef CONST_H
 #define CONST_H
 #include <Arduino.h>
+#ifdef SIM
+// Environnement de simulation (platformio_.ini, env:native)
+#include "simSecret.h"
+#else
 #include "../secret/password.h"
+#endif
 
 /** password.h 
 #ifdef PUBLIC_BROKER
@@ -25,10 +30,10 @@
 #endif
 */
 
-const String version = "2025.08.25 [D.T]";
+const char version[] = "2025.08.25 [D.T]";
 #define HOSTNAME "ROBOT_ESP"
 // FORCE permet de forcer la mise à jour des paramètres
-// à partir de la chaine PARAM
+// à partir des valeurs par défaut de paramSchema
 // #define POWER_DEBUG
 
 #define FORCE  false 
@@ -42,8 +47,39 @@ const String version = "2025.08.25 [D.T]";
 #define DEBUG_TIME
 #endif
 
-// Période d'appel du scheduler en ms
-#define TIMER_TIC 1000
+// Envoi des logs : taille maximale d'un paquet et d'une ligne
+// et nombre de paquets publiés par passage dans loop
+#define LOG_PACKET_MAX   256
+#define LOG_LINE_MAX     96
+#define LOG_PACKETS_PER_LOOP 1
+
+// Diagnostic : nombre de lignes (un message par ligne, voir formatDiag)
+// et taille maximale d'une ligne ou d'une section du profil
+#define DIAG_LINES    8
+#define DIAG_TEXT_MAX 160
+
+// Période d'écriture en flash des logs en attente en ms
+#define LOG_FLUSH_PERIOD 300000UL
+
+// Publier aussi la chaine complète TOPIC_PARAM lors de l'inversion
+// du sens en cours de cycle (anciennes versions de l'application)
+#define PARAM_LEGACY_PUSH 1
+
+// Publier aussi les messages TOPIC_STATUS, TOPIC_CYCLE_TIME et
+// TOPIC_SCHEDULED sur TOPIC_GET_STATUS (anciennes versions de l'application)
+#define STATUS_LEGACY_PUSH 1
+
+// Attente maximale de la connexion WiFi au boot en ms
+#define WIFI_BOOT_TIMEOUT 10000
+
+// Attente avant un nouvel essai du calendrier tant que l'heure n'est pas connue en ms
+#define CALENDAR_RETRY 60000UL
+
+// Période du timer matériel détectant les échéances des tâches en ms
+// (TIMER_IDLE_TIC au repos, loop() appelant alors schedule() au moins
+// toutes les POWER_MAX_LATENCY ms, voir power.h)
+#define TIMER_TIC 10
+#define TIMER_IDLE_TIC 1000
 
 // Port des relais utilisé par les moteurs du robot
 #ifdef WeMos_D1_Mini
@@ -55,52 +91,52 @@ const String version = "2025.08.25 [D.T]";
 #endif
 
 // Messages MQTT
+// Préfixe commun à tous les topics
+#define TOPIC_BASE         PREFIX "robot/"
 //-----------------Abonnements---------------------
-#define TOPIC_SET_PARAM    PREFIX "robot/param_set"
-#define TOPIC_GET_PARAM    PREFIX "robot/param_get"
-#define TOPIC_GET_VERSION  PREFIX "robot/versionGet"
-#define TOPIC_GET_LOGS     PREFIX "robot/logsGet"
-#define TOPIC_GET_STATUS   PREFIX "robot/getStatus"
-#define TOPIC_START        PREFIX "robot/start"
-#define TOPIC_MANUAL       PREFIX "robot/manual"
-#define TOPIC_DELETE_LOGS  PREFIX "robot/logsDelete"
-#define TOPIC_RESET        PREFIX "robot/reset"
+#define TOPIC_SET_PARAM    TOPIC_BASE "param_set"
+#define TOPIC_GET_PARAM    TOPIC_BASE "param_get"
+#define TOPIC_PATCH_PARAM  TOPIC_BASE "param_patch"
+#define TOPIC_GET_VERSION  TOPIC_BASE "versionGet"
+#define TOPIC_GET_LOGS     TOPIC_BASE "logsGet"
+#define TOPIC_GET_STATUS   TOPIC_BASE "getStatus"
+#define TOPIC_START        TOPIC_BASE "start"
+#define TOPIC_MANUAL       TOPIC_BASE "manual"
+#define TOPIC_DELETE_LOGS  TOPIC_BASE "logsDelete"
+#define TOPIC_RESET        TOPIC_BASE "reset"
+#define TOPIC_GET_DIAG     TOPIC_BASE "diagGet"
+#define TOPIC_SET_CALENDAR TOPIC_BASE "calendar_set"
+#define TOPIC_GET_CALENDAR TOPIC_BASE "calendar_get"
+#define TOPIC_GET_PROFILE  TOPIC_BASE "profileGet"
 
 // -------------Publications--------------------
-#define TOPIC_PARAM        PREFIX "robot/param"   
-#define TOPIC_READ_VERSION PREFIX "robot/readVersion"
-#define TOPIC_READ_LOGS    PREFIX "robot/readLogs"
-#define TOPIC_LOG_STATUS   PREFIX "robot/log_status"
-#define TOPIC_STATUS       PREFIX "robot/status"
-#define TOPIC_RESET_CYCLE  PREFIX "robot/reset_cycle"
-#define TOPIC_SCHEDULED    PREFIX "robot/scheduled"
-#define TOPIC_CYCLE_TIME   PREFIX "robot/cycle_time"
+#define TOPIC_PARAM        TOPIC_BASE "param"   
+#define TOPIC_PARAM_DELTA  TOPIC_BASE "param_delta"
+#define TOPIC_READ_VERSION TOPIC_BASE "readVersion"
+#define TOPIC_READ_LOGS    TOPIC_BASE "readLogs"
+#define TOPIC_LOG_STATUS   TOPIC_BASE "log_status"
+#define TOPIC_STATUS       TOPIC_BASE "status"
+#define TOPIC_RESET_CYCLE  TOPIC_BASE "reset_cycle"
+#define TOPIC_SCHEDULED    TOPIC_BASE "scheduled"
+#define TOPIC_CYCLE_TIME   TOPIC_BASE "cycle_time"
+#define TOPIC_DIAG         TOPIC_BASE "diag"
+#define TOPIC_CALENDAR     TOPIC_BASE "calendar"
+#define TOPIC_PROFILE      TOPIC_BASE "profile"
+// Trame d'état retenue (voir status.h)
+#define TOPIC_STATE        TOPIC_BASE "state"
 
 
 #define LOG_FILE_NAME "logs.txt"
 #define PARAM_FILE_NAME "r_param.txt"
 
-const char *ssid = SSID;
-const char *password = PASSWORD;
-const char *mqttServer = MQTT_SERVER;
+const char *const ssid = SSID;
+const char *const password = PASSWORD;
+const char *const mqttServer = MQTT_SERVER;
 const int mqttPort = MQTT_PORT;
-const char *mqttUser = MQTT_USER;
-const char *mqttPassword = MQTT_PASSWORD;
+const char *const mqttUser = MQTT_USER;
+const char *const mqttPassword = MQTT_PASSWORD;
 
 // Param robot
-// Chaine des paramètres de configuration
-const char *PARAM = "1:10:30:40:99:40:99:0:150:360:1";
-// Signification des champs
-#define SCHEDULED_ENABLE 0
-#define SCHEDULED_TIME_H 1
-#define SCHEDULED_TIME_M 2
-#define MIN_RANDOM_AV    3
-#define MAX_RAMDOM_AV    4
-#define MIN_RANDOM_AR    5
-#define MAX_RAMDOM_AR    6
-#define REVERSE          7
-#define N_CYCLES         8
-#define ACTIVE_TIME      9
-#define LOG_STATUS       10
-#define PARAM_LEN        11
+// Les champs de la chaine de configuration, leurs bornes et leurs
+// valeurs par défaut sont décrits par paramSchema (params.h)
 #endif
\ No newline at end of file
@@ -1,23 +1,26 @@
 #ifndef __FILE_H
 #define __FILE_H
-#include <string>
 #include <LittleFS.h>
 
+// Le système de fichiers est monté une seule fois (connectFs) et partagé
+// par toutes les instances. Existence et taille d'un fichier sont lues
+// directement (stat), sans parcours du répertoire.
 class FileLittleFS {
   char path[32];
   File file;
+  static boolean mounted;
 
 public:
   FileLittleFS(const char *filePath);
   //~FileLittleFS() {free(path); }
-  void connectFs();
+  static boolean connectFs();
   void listDir();
   boolean exist();
-  void purge(unsigned size);
-  String readFile();
+  int readInto(char *buffer, size_t size);
+  boolean openRead();
+  int readLine(char *buffer, unsigned size);
   int fileSize();
   void writeFile(const char *message, const char *mode);
-  void writeFile(String message, const char *mode);
   void deleteFile();
   void close();
 };
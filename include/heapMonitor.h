@@ -0,0 +1,62 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+#include <Arduino.h>
+
+// Surveillance du tas
+//
+// sample(), appelé toutes les HEAP_SAMPLE_PERIOD ms par une tâche,
+// relève la mémoire libre, la fragmentation (%) et le plus grand bloc
+// disponible, et tient à jour les pires valeurs depuis le boot et
+// depuis le début du cycle de nettoyage courant (startCycle()).
+// Chaque relevé est recopié en mémoire RTC : après un reset (chien de
+// garde, exception) l'état du tas juste avant est relu au boot suivant.
+// snapshot() fait un dernier relevé avant un redémarrage volontaire et
+// le marque comme tel.
+
+#define HEAP_SAMPLE_PERIOD 5000UL
+// Relevé en mémoire RTC utilisateur : blocs 101..110
+// (32..98 logStore, 99..100 calendar)
+#define HEAP_RTC_OFFSET 101
+#define HEAP_RTC_MAGIC  0x48454131
+
+struct HeapStat {
+  uint32_t freeHeap;
+  uint32_t maxBlock;
+  uint32_t fragmentation;
+};
+
+struct HeapRecord {
+  uint32_t magic;
+  uint32_t uptime;       // s
+  HeapStat last;         // dernier relevé
+  HeapStat worst;        // minimum libre et bloc, fragmentation maximale
+  uint32_t deliberate;   // redémarrage volontaire
+  uint32_t checksum;
+};
+
+static_assert(HEAP_RTC_OFFSET + sizeof(HeapRecord) / 4 <= 128, "HeapRecord dépasse la mémoire RTC");
+
+class HeapMonitor {
+private:
+  HeapStat last;
+  HeapStat worst;
+  HeapStat cycle;
+  HeapRecord previous;
+  boolean previousValid;
+  static void lower(HeapStat *worst, const HeapStat *stat);
+  static uint32_t checksum(const HeapRecord *record);
+  void rtcSave(boolean deliberate);
+public:
+  HeapMonitor();
+  void begin();
+  void sample();
+  void startCycle();
+  void snapshot();
+  const HeapStat *getLast();
+  const HeapStat *getWorst();
+  const HeapStat *getCycle();
+  const HeapRecord *getPrevious();
+};
+
+extern HeapMonitor heapMonitor;
+#endif
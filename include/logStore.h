@@ -0,0 +1,92 @@
+#ifndef LOG_STORE_H
+#define LOG_STORE_H
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "event.h"
+
+// Journal circulaire segmenté
+//
+// Les logs sont des enregistrements binaires (LogRecord, voir event.h)
+// répartis sur LOG_SEGMENTS fichiers d'au plus
+// LOG_SEGMENT_SIZE octets utilisés à tour de rôle. Lorsque le segment
+// courant est plein, le plus ancien est vidé et devient le segment
+// courant : la taille totale est bornée et seul l'historique le plus
+// ancien est perdu. L'index du segment courant est conservé dans
+// LOG_INDEX_NAME (écrit uniquement lors d'une rotation).
+// Un ancien fichier de logs texte unique (logs.txt) est converti en
+// enregistrements au boot (parseEvent, les lignes inconnues sont
+// ignorées) puis effacé : tout l'historique tient dans les segments.
+// La relecture (readLine) produit des lignes de texte. Elle s'étale sur
+// plusieurs passages dans loop() : l'ordre des segments est fixé à
+// l'ouverture (openRead) et une rotation qui viderait un segment non
+// encore lu est différée, les enregistrements restant dans le tampon.
+// Si le tampon est plein, la relecture est interrompue (fin anticipée
+// de l'envoi) plutôt que de perdre des enregistrements.
+//
+// Les écritures sont différées : les enregistrements sont accumulés en
+// RAM et écrits par lot (flush) lorsque LOG_FLUSH_THRESHOLD est atteint,
+// périodiquement (tâche créée dans main) et avant un redémarrage
+// volontaire. Le tampon est recopié en mémoire RTC à chaque ajout : il
+// survit à un reset chien de garde et est écrit au boot suivant.
+// Le segment courant reste ouvert en écriture (chaque ouverture alloue
+// un descripteur sur le tas) : un lot est écrit puis validé sur la flash
+// (flush du fichier) sans ouverture. Seules la rotation, l'effacement et
+// la relecture ouvrent des fichiers.
+
+#define LOG_SEGMENTS      4
+#define LOG_SEGMENT_SIZE  2048
+#define LOG_SEGMENT_NAME  "logs%u.bin"
+#define LOG_INDEX_NAME    "logs.idx"
+
+// Tampon d'écriture différée (en enregistrements)
+#define LOG_BUFFER_LEN       32
+#define LOG_FLUSH_THRESHOLD  16
+// Octets programmés en flash par validation d'un ajout (une page LittleFS,
+// données et métadonnées) : base du compteur d'octets économisés
+#define LOG_COMMIT_BYTES     256
+// Copie du tampon en mémoire RTC utilisateur (blocs de 4 octets)
+// Les 32 premiers blocs sont réservés à l'OTA (eboot), la copie
+// occupe 3 blocs d'en-tête + 2 blocs par enregistrement : 32..98
+#define LOG_RTC_OFFSET  32
+#define LOG_RTC_MAGIC   0x4c4f4731
+
+class LogStore {
+private:
+  unsigned current;
+  unsigned currentSize;
+  // Écriture : segment courant ouvert en ajout
+  File segment;
+  // Lecture : fichier ouvert, plus ancien segment lors de openRead() et
+  // numéro du prochain segment à lire (0..LOG_SEGMENTS-1 à partir de readFirst)
+  File file;
+  unsigned readFirst;
+  unsigned readStep;
+  // Écriture différée
+  LogRecord buffer[LOG_BUFFER_LEN];
+  unsigned buffered;
+  unsigned flushCount;
+  unsigned savedOpens;
+  unsigned long savedBytes;
+  void segmentName(char *name, unsigned segment);
+  void rotate();
+  unsigned write(const LogRecord *records, unsigned count, unsigned *opens);
+  void migrate(const char *legacyName);
+  boolean openNext();
+  boolean readPending(unsigned segment);
+  void rtcSave(unsigned index);
+  void rtcRestore();
+public:
+  LogStore();
+  void begin(const char *legacyName);
+  void append(const LogRecord *record);
+  void flush();
+  void clear();
+  boolean openRead();
+  int readLine(char *buffer, unsigned size);
+  void close();
+  unsigned getBuffered();
+  unsigned getFlushCount();
+  unsigned getSavedOpens();
+  unsigned long getSavedBytes();
+};
+#endif
@@ -1,25 +1,31 @@
 #ifndef __MAIN_H
 #define __MAIN_H
 
-#include <string>
 #include <Arduino.h>
 #include <ESP8266mDNS.h>
-#include <NTPClient.h>
 #include <WiFiUdp.h>
 #include <ArduinoOTA.h>
 #include <PubSubClient.h>
-#include <NTPClient.h>
 #include <CertStoreBearSSL.h>
 #include <time.h>
+#include <Ticker.h>
 #include "files.h"
+#include "logStore.h"
+#include "event.h"
+#include "params.h"
 #include "timerTask.h"
+#include "relay.h"
+#include "connection.h"
+#include "wallClock.h"
+#include "calendar.h"
+#include "power.h"
+#include "profile.h"
+#include "heapMonitor.h"
+#include "outbox.h"
+#include "status.h"
 #include "const.h"
 
-// Item d'un champ param
-struct Item {
-  char item[5];
-};
-
+// Date courante "jj/mm/aaaa hh:mm:ss" (getDate)
 char date[20];
 
 // Variables d'un cycle
@@ -34,50 +40,67 @@ int reverse_cycle;
 int nbCycles;
 int activeTime;
 int logStatus;
-unsigned currentRandomValue;
 
-int currentCycle;
-boolean activeScheduledTask;
-boolean direction;
+// État du cycle de nettoyage en cours, contexte des tâches du robot
+struct CleanCycle {
+  int count;              // mouvements effectués
+  boolean direction;      // sens du prochain mouvement
+  unsigned randomValue;   // durée du mouvement en cours en ms
+  uint32_t legStart;      // début du mouvement en cours (heure UTC, décalé après une suspension)
+  boolean scheduled;      // cycle démarré par le calendrier
+};
+CleanCycle cleanCycle;
 
 // Id des tâches
 task_id idRobotTask;
 task_id idEndRobotTask;
 task_id idScheduleCleanTask;
 task_id idMonoPowerTimeOffTask;
+task_id idLogFlushTask;
+task_id idHeapTask;
 
 // Buffers
-// tabParam doit être de la taille de PARAM+1 
-char tabParam[33];
+// Paramètres courants et chaine correspondante publiée sur TOPIC_PARAM
+// tabParam doit pouvoir contenir la chaine de tous les champs à leur maximum
+Params params;
+char tabParam[48];
 char bufferTime[30];
 char randomBuffer[12];
+// Envoi des logs en cours et ligne en attente
+boolean logSending;
+char logLine[LOG_LINE_MAX];
+// Envoi en cours du diagnostic et du profil et prochain message
+boolean diagSending;
+unsigned diagLine;
+boolean profileSending;
+unsigned profileSection;
+boolean profileReset;
 
 // Objets utilisés
-FileLittleFS* fileLog;
-FileLittleFS *fileParam;
+LogStore logStore;
 Task timerTask;
+Ticker schedulerTicker;
+Relay relay;
 WiFiClient wifiClient;
 PubSubClient mqttClient(wifiClient);
-NTPClient* ntpTime;
+Connection connection;
+// File d'émission des messages MQTT
+Outbox outbox;
+// Socket des échanges SNTP de wallClock
 WiFiUDP ntpUDP;
+WallClock wallClock;
+Calendar calendar;
+Power power;
+// Trame d'état publiée sur TOPIC_STATE
+StatusPublisher statusPublisher;
 
 void PubSubCallback(char* topic, byte* payload, unsigned int length);
-void writeLogs(const char * msg);
-void logsWrite(const char *msg);
+void writeLogs(uint8_t code);
+void logsWrite(uint8_t code, uint16_t arg);
 void deleteLogs();
-Item* split(char* str, const char* motif);
 char* getDate();
-void robotEndTask();
-
-// Fonctions permettant de manipuler les items des paramètres
-// Comparer deux items
-inline boolean cmp(const char* s1, const char* s2) {
-  return strcmp(s1, s2) == 0;
-}
-// Obtenir un item
-inline char* get(Item* paramItem, int PARAM) {
-  return (&paramItem[PARAM])->item;
-}
+void robotEndTask(void* context);
+void planCalendar();
 
 inline void debugPrintParam() {
   Serial.println(tabParam);
@@ -91,28 +114,27 @@ inline void debugPrintParam() {
 }
 
 // Commande du moteur de traction
+// Les relais sont séquencés sans blocage par relay (temps mort
+// et durée minimale de marche), voir relay.h
 inline void powerOff() {
 #ifdef POWER_DEBUG  
   Serial.println("powerOff");
 #endif
-  digitalWrite(GPIO0_RETURN, HIGH);
-  digitalWrite(GPIO2_FORWARD, HIGH);
+  relay.command(R_OFF);
 }
 
 inline void robotForward() {
 #ifdef POWER_DEBUG  
   Serial.println("forward");
 #endif  
-  digitalWrite(GPIO2_FORWARD, LOW);
-  digitalWrite(GPIO0_RETURN, HIGH);
+  relay.command(R_FORWARD);
 }
 
 inline void robotReturn() {
 #ifdef POWER_DEBUG  
   Serial.println("robotReturn");
 #endif  
-  digitalWrite(GPIO2_FORWARD, HIGH);
-  digitalWrite(GPIO0_RETURN, LOW);
+  relay.command(R_RETURN);
 }
 
 #endif
\ No newline at end of file
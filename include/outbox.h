@@ -0,0 +1,74 @@
+#ifndef OUTBOX_H
+#define OUTBOX_H
+#include <Arduino.h>
+#include <PubSubClient.h>
+
+// File d'émission des messages MQTT
+//
+// Tous les messages publiés passent par post() et sont rangés dans une
+// file de capacité fixe (OUTBOX_LEN messages, sans allocation) ; drain(),
+// appelé à chaque passage dans loop(), en publie au plus
+// OUTBOX_PER_LOOP. Un message n'est retiré de la file qu'une fois
+// accepté par le client MQTT : pendant une coupure du courtier les
+// messages attendent la reconnexion.
+// Les messages d'événement (OB_EVENT) sont publiés dans l'ordre. Un
+// échec de publication alors que le client est connecté est réessayé
+// après OUTBOX_RETRY_DELAY ms, au plus OUTBOX_MAX_RETRY fois, le message
+// étant ensuite abandonné.
+// Un message d'état (OB_STATE) remplace le message du même topic encore
+// en attente, à sa place dans la file : seule la dernière valeur est
+// publiée.
+// Lorsque la file est pleine, le nouveau message est abandonné.
+
+// Nombre de messages en attente
+#ifndef OUTBOX_LEN
+#define OUTBOX_LEN 12
+#endif
+// Taille maximale d'un message : buffer de PubSubClient (256) moins
+// l'en-tête, la longueur et le topic le plus court
+#define OUTBOX_PAYLOAD_MAX 232
+// Messages publiés par passage dans loop
+#define OUTBOX_PER_LOOP   4
+// Délai avant un nouvel essai en ms et nombre maximal d'essais
+#define OUTBOX_RETRY_DELAY 200
+#define OUTBOX_MAX_RETRY   5
+
+// Options de post()
+#define OB_EVENT  0
+#define OB_STATE  1
+#define OB_RETAIN 2
+
+class Outbox {
+private:
+  struct Message {
+    const char *topic;      // topic constant (const.h), non copié
+    uint8_t flags;
+    uint8_t retries;
+    uint16_t length;
+    char payload[OUTBOX_PAYLOAD_MAX];
+  };
+  PubSubClient *client;
+  Message queue[OUTBOX_LEN];
+  unsigned head;
+  unsigned count;
+  unsigned long nextAttempt;
+  // Métriques
+  unsigned maxDepth;
+  unsigned long sent;
+  unsigned retries;
+  unsigned drops;
+  unsigned coalesced;
+public:
+  Outbox();
+  void begin(PubSubClient &client);
+  boolean post(const char *topic, const char *payload, uint8_t flags = OB_EVENT);
+  void drain();
+  unsigned getDepth();
+  unsigned getFree();
+  unsigned getMaxDepth();
+  unsigned long getSent();
+  unsigned getRetries();
+  unsigned getDrops();
+  unsigned getCoalesced();
+};
+#endif
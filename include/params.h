@@ -0,0 +1,131 @@
+#ifndef PARAMS_H
+#define PARAMS_H
+#include <Arduino.h>
+#include <stddef.h>
+
+// Stockage binaire des paramètres du robot
+//
+// Les paramètres sont enregistrés sous forme d'une structure binaire
+// versionnée et protégée par un CRC, écrite alternativement dans deux
+// fichiers (A/B). Chaque écriture porte un numéro de séquence : au boot
+// on charge l'enregistrement valide le plus récent. Une coupure pendant
+// une écriture ne peut donc corrompre que l'emplacement en cours
+// d'écriture, l'autre conservant le jeu de paramètres précédent.
+// L'ancien format texte ("1:10:30:...") est migré par main.
+//
+// Le schéma des paramètres (paramSchema) décrit à la compilation chaque
+// champ : nom, type, bornes, valeur par défaut et mise à l'échelle en
+// mode DEBUG. Il est utilisé pour analyser la chaine texte sans copie
+// ni allocation (paramParse), la produire (paramFormat) et n'en
+// réécrire qu'un champ (paramPatch).
+// Les modifications partielles utilisent le format "nom=valeur;nom=valeur"
+// avec les noms du schéma (paramParsePatch, paramFormatDelta). Les
+// champs modifiés sont repérés par un masque de bits (1 << ParamId).
+
+#define PARAM_SLOT_A  "r_param_a.bin"
+#define PARAM_SLOT_B  "r_param_b.bin"
+#define PARAM_MAGIC   0x5250
+#define PARAM_VERSION 1
+// Longueur maximale lue de l'ancien fichier texte des paramètres
+#define PARAM_TEXT_MAX 64
+
+// Paramètres, dans l'ordre des champs de la chaine de configuration
+struct Params {
+  int16_t scheduleEnabled;
+  int16_t scheduleH;
+  int16_t scheduleM;
+  int16_t minRandomAv;
+  int16_t maxRandomAv;
+  int16_t minRandomAr;
+  int16_t maxRandomAr;
+  int16_t reverse;
+  int16_t nbCycles;
+  int16_t activeTime;
+  int16_t logStatus;
+};
+
+// Indices des champs, dans l'ordre de la chaine et de Params
+enum ParamId {
+  P_SCHEDULE_ENABLE,
+  P_SCHEDULE_H,
+  P_SCHEDULE_M,
+  P_MIN_RANDOM_AV,
+  P_MAX_RANDOM_AV,
+  P_MIN_RANDOM_AR,
+  P_MAX_RANDOM_AR,
+  P_REVERSE,
+  P_N_CYCLES,
+  P_ACTIVE_TIME,
+  P_LOG_STATUS,
+  PARAM_LEN
+};
+
+// Types de champ
+#define PT_BOOL 0
+#define PT_INT  1
+
+struct ParamField {
+  const char *name;
+  uint8_t type;
+  uint8_t offset;
+  int16_t min;
+  int16_t max;
+  int16_t defaultValue;
+  // Valeur divisée par DEBUG_TIME en mode DEBUG (durées et nombre de cycles)
+  boolean scaled;
+};
+
+constexpr ParamField paramSchema[PARAM_LEN] = {
+  { "sched",  PT_BOOL, offsetof(Params, scheduleEnabled), 0, 1,    1,   false },
+  { "hour",   PT_INT,  offsetof(Params, scheduleH),       0, 23,   10,  false },
+  { "min",    PT_INT,  offsetof(Params, scheduleM),       0, 59,   30,  false },
+  { "avMin",  PT_INT,  offsetof(Params, minRandomAv),     1, 3600, 40,  true },
+  { "avMax",  PT_INT,  offsetof(Params, maxRandomAv),     1, 3600, 99,  true },
+  { "arMin",  PT_INT,  offsetof(Params, minRandomAr),     1, 3600, 40,  true },
+  { "arMax",  PT_INT,  offsetof(Params, maxRandomAr),     1, 3600, 99,  true },
+  { "rev",    PT_BOOL, offsetof(Params, reverse),         0, 1,    0,   false },
+  { "cycles", PT_INT,  offsetof(Params, nbCycles),        1, 1000, 150, true },
+  { "time",   PT_INT,  offsetof(Params, activeTime),      1, 1440, 360, true },
+  { "log",    PT_BOOL, offsetof(Params, logStatus),       0, 1,    1,   false },
+};
+
+// Cohérence du schéma avec la structure Params
+constexpr boolean schemaOrdered(int i) {
+  return i >= PARAM_LEN ||
+    (paramSchema[i].offset == i * sizeof(int16_t) && paramSchema[i].min <= paramSchema[i].defaultValue
+      && paramSchema[i].defaultValue <= paramSchema[i].max && schemaOrdered(i + 1));
+}
+static_assert(sizeof(Params) == PARAM_LEN * sizeof(int16_t), "paramSchema ne couvre pas Params");
+static_assert(schemaOrdered(0), "paramSchema incohérent avec Params");
+
+// Accès à un champ par son indice
+inline int16_t paramGet(const Params *params, int id) {
+  return *(const int16_t *)((const uint8_t *)params + paramSchema[id].offset);
+}
+
+inline void paramSet(Params *params, int id, int16_t value) {
+  *(int16_t *)((uint8_t *)params + paramSchema[id].offset) = value;
+}
+
+struct ParamRecord {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t size;
+  uint16_t sequence;
+  Params params;
+  uint16_t crc;
+};
+
+boolean paramLoad(Params *params);
+boolean paramSave(const Params *params);
+void paramDefaults(Params *params);
+boolean paramParse(const char *text, unsigned length, Params *params);
+uint16_t paramMigrate(const char *text, unsigned length, Params *params);
+boolean paramParseField(int id, const char *text, unsigned length, int16_t *value);
+int paramFormat(const Params *params, char *buffer, unsigned size);
+boolean paramPatch(char *buffer, unsigned size, const Params *params, int id);
+int paramFind(const char *name, unsigned length);
+uint16_t paramDiff(const Params *a, const Params *b);
+boolean paramParsePatch(const char *text, unsigned length, Params *params);
+int paramFormatDelta(const Params *params, uint16_t mask, char *buffer, unsigned size);
+#endif
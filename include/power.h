@@ -0,0 +1,53 @@
+#ifndef POWER_H
+#define POWER_H
+#include <Arduino.h>
+
+// Gestion de l'énergie entre deux cycles de nettoyage
+//
+// Lorsque rien n'est en cours (pas de cycle, moteur arrêté, pas d'envoi
+// de logs), update(), appelé en fin de loop(), place le WiFi en veille
+// (modem-sleep ou light-sleep selon POWER_IDLE_MODE) et laisse le
+// processeur au repos par delay() jusqu'à la prochaine échéance des
+// tâches, sans dépasser POWER_MAX_LATENCY : c'est le délai maximal de
+// prise en compte d'une commande MQTT. Le point d'accès conserve les
+// messages pendant la veille (intervalle d'écoute des balises déduit
+// de POWER_MAX_LATENCY).
+// Dès qu'une activité reprend, update() repasse en mode actif (WiFi
+// sans veille). Au démarrage d'un cycle (calendrier ou commande), main
+// appelle update(true, 0) avant la première exécution de robotTask().
+// Le temps passé dans chaque état est cumulé pour mesurer le gain.
+
+#define P_ACTIVE 0
+#define P_MODEM  1
+#define P_LIGHT  2
+#define POWER_STATES 3
+
+// État de repos : P_MODEM ou P_LIGHT
+#ifndef POWER_IDLE_MODE
+#define POWER_IDLE_MODE P_LIGHT
+#endif
+// Délai maximal de prise en compte d'une commande MQTT au repos en ms
+#ifndef POWER_MAX_LATENCY
+#define POWER_MAX_LATENCY 1000
+#endif
+// Intervalle entre deux balises WiFi en ms (102,4 ms)
+#define POWER_BEACON_INTERVAL 102
+
+static_assert(POWER_IDLE_MODE == P_MODEM || POWER_IDLE_MODE == P_LIGHT, "POWER_IDLE_MODE");
+static_assert(POWER_MAX_LATENCY < 15000, "POWER_MAX_LATENCY doit rester inférieur au keepalive MQTT");
+
+class Power {
+private:
+  unsigned state;
+  unsigned long since;
+  unsigned long time[POWER_STATES];
+  unsigned wakeCount;
+  void enter(unsigned state);
+public:
+  Power();
+  void update(boolean busy, unsigned long idleTime);
+  unsigned getState();
+  unsigned long getTime(unsigned state);
+  unsigned getWakeCount();
+};
+#endif
@@ -0,0 +1,62 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <Arduino.h>
+
+// Mesure des temps d'exécution de loop()
+//
+// Chaque section de loop() est chronométrée avec le compteur de cycles
+// du processeur (ESP.getCycleCount(), une instruction) et sa durée en µs
+// est rangée dans un histogramme à seuils fixes : la classe i contient
+// les durées de 2^i à 2^(i+1) - 1 µs, la dernière les durées supérieures.
+// Le p99 est la borne haute de la classe atteignant 99 % des mesures,
+// le maximum est exact. Le retard de chaque exécution de tâche
+// (timerTask) par rapport à son échéance est suivi de la même façon.
+// Le coût d'une mesure est de quelques dizaines de cycles : la mesure
+// reste active en production.
+// Le compteur de cycles reboucle toutes les 53 s à 80 MHz, une section
+// plus longue serait mal mesurée.
+
+// Sections
+#define PS_LOOP       0   // loop() hors veille
+#define PS_NETWORK    1   // connection.update() et wallClock.update()
+#define PS_OTA        2   // ArduinoOTA.handle()
+#define PS_MQTT       3   // mqttClient.loop() et gestionnaires des messages
+#define PS_SCHEDULE   4   // timerTask.schedule() et fonctions des tâches
+#define PS_RELAY      5   // relay.update()
+#define PS_LOGS       6   // pumpLogs() et pumpReplies()
+#define PS_TIMER_LATE 7   // retard des tâches sur leur échéance
+#define PS_PUBLISH    8   // statusUpdate() et outbox.drain()
+#define PROFILE_SECTIONS 9
+
+#define PROFILE_BUCKETS 16
+#define CYCLES_PER_US (F_CPU / 1000000L)
+
+class Profiler {
+private:
+  struct Histogram {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+    uint32_t buckets[PROFILE_BUCKETS];
+  };
+  Histogram histograms[PROFILE_SECTIONS];
+public:
+  Profiler();
+  void record(unsigned section, uint32_t us);
+  // Enregistre la durée d'une section commencée à start (cycles)
+  // et retourne le début de la section suivante
+  inline uint32_t lap(unsigned section, uint32_t start) {
+    uint32_t now = ESP.getCycleCount();
+    record(section, (now - start) / CYCLES_PER_US);
+    return now;
+  }
+  uint32_t getCount(unsigned section);
+  uint32_t getMax(unsigned section);
+  uint32_t getMean(unsigned section);
+  uint32_t getP99(unsigned section);
+  int format(unsigned section, char *buffer, unsigned size);
+  void reset();
+};
+
+extern Profiler profiler;
+#endif
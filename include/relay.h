@@ -0,0 +1,45 @@
+#ifndef RELAY_H
+#define RELAY_H
+#include <Arduino.h>
+
+// Séquenceur des relais de traction
+//
+// Les deux relais (avance / recul) ne doivent jamais être commandés
+// simultanément et un changement de sens doit être précédé d'un temps
+// mort moteur coupé. Plutôt que de bloquer loop() avec delay(), les
+// commandes sont mémorisées et appliquées par update(), appelé à chaque
+// passage dans loop() :
+//   OFF -> SETTLE (temps mort) -> FORWARD ou RETURN
+// Seule la dernière commande reçue est conservée : plusieurs commandes
+// arrivant pendant le temps mort sont fusionnées.
+// Un sens de marche est maintenu au moins RELAY_MIN_ON_TIME ms avant
+// un changement de sens. L'arrêt est toujours immédiat.
+
+// Temps mort moteur coupé avant la mise sous tension en ms
+#define RELAY_DEAD_TIME    500
+// Durée minimale d'un sens de marche avant inversion en ms
+#define RELAY_MIN_ON_TIME  2000
+
+// Commandes et états
+#define R_OFF     0
+#define R_FORWARD 1
+#define R_RETURN  2
+#define R_SETTLE  3
+
+class Relay {
+private:
+  int pinForward;
+  int pinReturn;
+  unsigned state;
+  unsigned request;
+  unsigned long since;
+  void output(unsigned cmd);
+public:
+  Relay();
+  void begin(int pinForward, int pinReturn);
+  void command(unsigned cmd);
+  void update();
+  unsigned getState();
+  unsigned getRequest();
+};
+#endif
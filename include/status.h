@@ -0,0 +1,72 @@
+#ifndef STATUS_H
+#define STATUS_H
+#include <Arduino.h>
+#include "outbox.h"
+
+// Trame d'état unique
+//
+// L'état du robot est publié en une seule trame retenue (retained) :
+// une application qui se connecte la reçoit aussitôt du courtier, sans
+// requête. La trame n'est republiée que si un de ses champs a changé,
+// au plus une fois toutes les STATUS_MIN_INTERVAL ms ; un changement
+// plus rapproché est publié à l'échéance suivante. due() indique toutes
+// les STATUS_CHECK_PERIOD ms s'il faut relever l'état (update()).
+// La trame passe par la file d'émission (outbox.h) comme message d'état :
+// une trame non encore envoyée est remplacée par la suivante.
+//
+// Format : "cycle=3/150;t=12/180;run=1;leg=AV;p=1748853034/60;sch=10:30;next=03/06 10:30"
+//  cycle  mouvement en cours / nombre de mouvements du cycle
+//  t      durée écoulée / durée maximale du cycle (mn)
+//  run    0 arrêt, 1 en cours, 2 suspendu
+//  leg    sens du mouvement en cours (AV, AR, - à l'arrêt)
+//  p      début (heure UTC, s) / durée du mouvement en cours (s), 0/0 à
+//         l'arrêt. La progression est déduite par l'application : la
+//         trame ne change pas pendant le mouvement. Après une suspension
+//         le début est décalé de sa durée.
+//  sch    heure de démarrage du cycle programmé en cours (- sinon)
+//  next   prochain nettoyage programmé (- inconnu)
+
+// Intervalle minimal entre deux publications en ms
+#ifndef STATUS_MIN_INTERVAL
+#define STATUS_MIN_INTERVAL 5000UL
+#endif
+// Période de relevé de l'état en ms
+#define STATUS_CHECK_PERIOD 1000UL
+#define STATUS_TEXT_MAX 96
+
+#define ST_STOPPED   0
+#define ST_RUNNING   1
+#define ST_SUSPENDED 2
+
+struct StatusFrame {
+  unsigned cycle;
+  unsigned cycles;
+  unsigned elapsed;      // mn
+  unsigned total;        // mn
+  unsigned run;          // ST_STOPPED, ST_RUNNING, ST_SUSPENDED
+  boolean forward;       // sens du mouvement en cours
+  uint32_t legStart;     // début du mouvement en cours (heure UTC)
+  unsigned legTotal;     // s
+  uint32_t scheduled;    // démarrage du cycle programmé en cours (heure locale), 0 sinon
+  uint32_t nextRun;      // prochain nettoyage programmé (heure locale), 0 inconnu
+};
+
+class StatusPublisher {
+private:
+  Outbox *outbox;
+  const char *topic;
+  char published[STATUS_TEXT_MAX];
+  unsigned long lastPublish;
+  unsigned long lastCheck;
+  unsigned publishCount;
+  boolean send(const char *text);
+public:
+  StatusPublisher();
+  void begin(Outbox &outbox, const char *topic);
+  static int format(const StatusFrame *frame, char *buffer, unsigned size);
+  boolean due();
+  boolean update(const StatusFrame *frame);
+  boolean publish(const StatusFrame *frame);
+  unsigned getPublishCount();
+};
+#endif
@@ -9,14 +9,40 @@
 // programmation de cette application basée sur l'exécution d'actions
 // régies par le temps
 // Les monostatbles sont construit sur un mécanisme des tâches
-// Les tâches sont identifiées par un entier
-// et sont mémorisées dans un tableau.
-// L'ordonnancement est circulaire et l'ordonnanceur
-// est lancé touté les secondes dans loop
+// Les tâches sont mémorisées dans un tableau statique de MAX_TASK
+// emplacements, sans allocation dynamique. Une tâche est identifiée par
+// un task_id combinant l'indice de son emplacement et la génération de
+// celui-ci, incrémentée à chaque création : un identifiant conservé
+// après t_delete() est rejeté (sans effet) même si l'emplacement a été
+// réutilisé par une autre tâche.
+// La fonction d'une tâche reçoit le contexte fourni à sa création.
+// Les tâches prêtes sont rangées dans un tas (min-heap) trié
+// par échéance absolue exprimée en ms (valeur de millis()) :
+// l'ordonnanceur, appelé à chaque passage dans loop, ne consulte
+// que la tête du tas. Un appel sans échéance coûte O(1), une
+// échéance O(log n). Les comparaisons se font par différence signée
+// afin de supporter le rebouclage de millis() (49 jours).
+// Les échéances sont détectées par tic(), appelé par un timer matériel
+// (Ticker) même lorsque loop() est bloqué par le réseau. tic() se
+// contente de placer les tâches échues dans une file d'exécutions
+// différées que schedule() vide depuis loop(). Chaque échéance manquée
+// est ainsi rattrapée.
 // Les timers sont utilisés pour lancer des fonctions à intervalle 
 // régulier
 
-#define MAX_TASK  4
+// Nombre d'emplacements de tâches (5 utilisés par main)
+#ifndef MAX_TASK
+#define MAX_TASK  8
+#endif
+// Identifiant : génération << TASK_INDEX_BITS | indice de l'emplacement
+#ifndef TASK_INDEX_BITS
+#define TASK_INDEX_BITS 8
+#endif
+#define TASK_GENERATION_MAX ((1U << (31 - TASK_INDEX_BITS)) - 1)
+#define TASK_NONE -1
+static_assert(MAX_TASK > 0 && MAX_TASK <= (1 << TASK_INDEX_BITS), "MAX_TASK");
+// Taille de la file des exécutions différées (puissance de 2)
+#define READY_QUEUE_LEN 16
 
 #define N_CREE    0
 #define CREE      1
@@ -25,44 +51,77 @@
 #define SUSP      3
 
 typedef int task_id;
+typedef void (*TaskFunction)(void *context);
 
 /**
  * @class Task
  * @brief Represents a scheduled task.
  *
  * The Task class encapsulates the attributes and methods to manipulate a task, including creating,
- * starting, stopping, scheduling, and deleting tasks. Each task holds a function pointer to be executed,
- * its current status, and timing details.
+ * starting, stopping, scheduling, and deleting tasks. Each task holds a function pointer to be executed
+ * with its context, its current status, and timing details.
  */
 class Task {
 private:
-  void (*fonc)(void);
+  TaskFunction fonc;
+  void *context;
+  // Génération de l'emplacement, incrémentée à chaque création
+  unsigned generation;
   unsigned status;
+  // État avant t_suspend()
+  unsigned lastStatus;
   unsigned currentTime;
   unsigned startTime;
+  // Échéance absolue (millis()) et position dans le tas, -1 si absente
+  unsigned deadline;
+  int heapIndex;
+  // Nombre d'exécutions en attente dans la file différée
+  volatile unsigned pending;
   boolean timerTask;
+  // Gestion du tas des échéances
+  static boolean before(int a, int b);
+  static void heapSwap(int i, int j);
+  static void siftUp(int i);
+  static void siftDown(int i);
+  static void heapPush(int taskId);
+  static void heapRemove(int taskId);
+  static void heapUpdate(int taskId);
+  static unsigned elapsed(int taskId);
+  static int slot(task_id id);
+  static task_id handle(int taskId);
+  static void printSlot(int taskId);
 public:
   Task();
-  Task(void (*fonc)(void), unsigned startTime) {
+  Task(TaskFunction fonc, void *context, unsigned startTime) {
     this->fonc = fonc;
+    this->context = context;
+    this->generation = 0;
+    this->lastStatus = CREE;
     this->startTime = startTime;
     this->currentTime = 0;
+    this->deadline = 0;
+    this->heapIndex = -1;
+    this->pending = 0;
     this->status = CREE;
   }
-  task_id t_creer(void (*fonc)(void), unsigned stopTime, boolean isTimer);
-  void t_start(int taskId);
-  void t_stop(int taskId);
-  void t_suspend(int taskId);
-  void t_resume(int taskid);
-  void t_delete(int taskId);
-  void setInterval(int taskId, unsigned interval);
+  task_id t_creer(TaskFunction fonc, void *context, unsigned stopTime, boolean isTimer);
+  void t_start(task_id id);
+  void t_stop(task_id id);
+  void t_suspend(task_id id);
+  void t_resume(task_id id);
+  void t_delete(task_id id);
+  void setInterval(task_id id, unsigned interval);
+  static void tic();
   void schedule();
-  void printStatus(int taskId);
+  unsigned idleTime();
+  unsigned getQueueOverflow();
+  unsigned getTaskCount();
+  void printStatus(task_id id);
   void printStatusAll();
-  int  getStatus(int taskId);
-  unsigned getCurrentTime(int taskId);
-  unsigned getStartTime(int taskId);
-  void setCurrentTime(int taskId, unsigned time);
-  void setStartTime(int taskId, unsigned time);
+  int  getStatus(task_id id);
+  unsigned getCurrentTime(task_id id);
+  unsigned getStartTime(task_id id);
+  void setCurrentTime(task_id id, unsigned time);
+  void setStartTime(task_id id, unsigned time);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef WALL_CLOCK_H
+#define WALL_CLOCK_H
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+// Horloge murale
+//
+// L'heure UTC est obtenue par NTP toutes les CLOCK_SYNC_INTERVAL ms
+// (CLOCK_RETRY_INTERVAL tant que la synchronisation n'a pas réussi).
+// Entre deux synchronisations elle est déduite de millis(). L'heure
+// locale suit les règles européennes (CET/CEST) : passage à l'heure
+// d'été le dernier dimanche de mars et retour le dernier dimanche
+// d'octobre à 01:00 UTC. Les règles sont des constexpr évaluables à la
+// compilation. La date décomposée est mise en cache et n'est recalculée
+// qu'au changement de seconde. Aucune fonction n'alloue de mémoire.
+//
+// L'échange SNTP ne bloque pas loop() : update() émet la requête et lit
+// la réponse lors d'un passage suivant (abandon après CLOCK_NTP_TIMEOUT).
+// L'heure du serveur (secondes et fraction) est datée au milieu de
+// l'aller-retour, soit une référence à la ms près : correction et dérive
+// ne sont pas limitées par la résolution d'une seconde. Seule la
+// résolution DNS du serveur est bloquante ; elle n'a lieu qu'au boot et
+// après CLOCK_NTP_MAX_FAILURES échecs consécutifs. Au boot, begin()
+// attend la première réponse afin de dater les premiers logs.
+
+#define CLOCK_SYNC_INTERVAL  3600000UL
+#define CLOCK_RETRY_INTERVAL 60000UL
+#define CLOCK_NTP_SERVER     "pool.ntp.org"
+#define CLOCK_NTP_PORT       123
+#define CLOCK_NTP_LOCAL_PORT 2390
+#define CLOCK_NTP_TIMEOUT    1000UL
+#define CLOCK_NTP_MAX_FAILURES 3
+#define NTP_PACKET_SIZE      48
+// Secondes du 01/01/1900 (origine NTP) au 01/01/1970
+#define NTP_UNIX_OFFSET      2208988800UL
+
+// Fuseau : décalages en secondes
+#define TZ_STD_OFFSET 3600
+#define TZ_DST_OFFSET 7200
+
+struct DateTime {
+  int16_t year;
+  int8_t month;    // 1..12
+  int8_t day;      // 1..31
+  int8_t hour;
+  int8_t minute;
+  int8_t second;
+  int8_t weekday;  // 0 = dimanche
+};
+
+// Nombre de jours depuis le 01/01/1970 (algorithme de H. Hinnant)
+constexpr long daysFromCivil(long y, unsigned m, unsigned d) {
+  return (y - (m <= 2)) / 400 * 146097 - 719468
+    + (((y - (m <= 2)) % 400 + 400) % 400) * 365 + (((y - (m <= 2)) % 400 + 400) % 400) / 4
+    - (((y - (m <= 2)) % 400 + 400) % 400) / 100
+    + (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+}
+
+// Jour de la semaine (0 = dimanche) d'un nombre de jours depuis 1970
+constexpr unsigned weekdayFromDays(long days) {
+  return (unsigned)(days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6);
+}
+
+// Jour du dernier dimanche d'un mois de 31 jours
+constexpr unsigned lastSunday(long y, unsigned m) {
+  return 31 - weekdayFromDays(daysFromCivil(y, m, 31));
+}
+
+// Début et fin de l'heure d'été (epoch UTC) pour une année
+constexpr uint32_t dstStart(long y) {
+  return (daysFromCivil(y, 3, lastSunday(y, 3)) * 86400L) + 3600;
+}
+constexpr uint32_t dstEnd(long y) {
+  return (daysFromCivil(y, 10, lastSunday(y, 10)) * 86400L) + 3600;
+}
+
+static_assert(lastSunday(2025, 3) == 30 && lastSunday(2025, 10) == 26, "règle CEST");
+static_assert(dstStart(2025) == 1743296400UL, "règle CEST");
+
+uint32_t utcToLocal(uint32_t utc);
+uint32_t localToUtc(uint32_t local);
+void epochToDateTime(uint32_t epoch, DateTime *dateTime);
+int formatDateTime(const DateTime *dateTime, char *buffer, unsigned size);
+
+class WallClock {
+private:
+  WiFiUDP *udp;
+  const char *server;
+  IPAddress serverIP;
+  boolean resolved;
+  // Requête en attente de réponse, date d'envoi et échecs consécutifs
+  boolean pending;
+  unsigned long sentAt;
+  unsigned failures;
+  boolean synced;
+  uint32_t baseEpoch;
+  unsigned long baseMillis;
+  unsigned long lastAttempt;
+  // Cache de l'heure locale décomposée
+  uint32_t cachedEpoch;
+  DateTime cached;
+  // Métriques
+  unsigned long syncInterval;
+  long lastCorrection;
+  long drift;
+  boolean request();
+  boolean receive();
+public:
+  WallClock();
+  void begin(WiFiUDP *udp, const char *server);
+  void update();
+  boolean isSynced();
+  uint32_t utc();
+  uint32_t local();
+  const DateTime *now();
+  int format(char *buffer, unsigned size);
+  unsigned long getSyncInterval();
+  long getLastCorrection();
+  long getDrift();
+};
+#endif
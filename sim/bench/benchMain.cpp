@@ -0,0 +1,342 @@
+/**
+ * @file benchMain.cpp
+ * @brief Microbenchmarks of the firmware hot paths on the host (bench environment).
+ *
+ * Each benchmark runs one path of the firmware (scheduler pass, loop section timing, parameter
+ * parsing and application, MQTT dispatch, status publication, log and file appends) against the
+ * simulation HAL, after setup(). The number of iterations is doubled until a run lasts BENCH_MIN_TIME ms.
+ * Results are given per operation: host time in ns, dynamic allocations and allocated bytes.
+ * Host times are only meaningful relative to each other and across versions, not as ESP8266
+ * timings; allocation counts are the same as on the target for the firmware code.
+ * MQTT dispatch, parameter parsing and file lookups are compared with their former implementations
+ * (legacy.cpp); the file system then holds BENCH_FILES additional files. Dispatch is measured with
+ * short commands and with parameter messages longer than the String small buffer.
+ * tic() and schedule() are also measured with 4, 32 and 256 armed timers, which needs the larger
+ * MAX_TASK set by the bench environment.
+ *
+ * Usage: pio run -e bench && .pio/build/bench/program [results.json]
+ * The results are printed as JSON and also written to the file given as argument.
+ */
+#include <Arduino.h>
+#include <chrono>
+#include "timerTask.h"
+#include "logStore.h"
+#include "files.h"
+#include "params.h"
+#include "profile.h"
+#include "outbox.h"
+#include "const.h"
+#include <PubSubClient.h>
+
+// Objets et fonctions du firmware (main.cpp)
+extern Task timerTask;
+extern LogStore logStore;
+extern Params params;
+extern char tabParam[];
+extern task_id idLogFlushTask;
+extern task_id idHeapTask;
+extern task_id idScheduleCleanTask;
+extern volatile unsigned readyHead;
+extern volatile unsigned readyTail;
+void setup();
+void setParam(const Params* p);
+void publishState();
+extern Outbox outbox;
+void statusUpdate();
+void PubSubCallback(char* topic, byte* payload, unsigned int length);
+// Anciennes implémentations (legacy.cpp)
+void legacyDispatch(char* topic, byte* payload, unsigned int length);
+void legacyParse(const char* tabParam, Params* params);
+boolean legacyExist(const char *path);
+int legacyFileSize(const char *path);
+
+// Fichiers ajoutés au système de fichiers pour les mesures des accès aux métadonnées
+#define BENCH_FILES 200
+
+// Durée minimale d'une mesure en ms
+#define BENCH_MIN_TIME 200
+
+struct BenchResult {
+  const char *name;
+  unsigned long iterations;
+  double nsPerOp;
+  double allocsPerOp;
+  double bytesPerOp;
+};
+
+static BenchResult results[48];
+static int resultCount = 0;
+
+/**
+ * @brief Measures body over a growing number of iterations and records the last run.
+ */
+template <class F> static void bench(const char *name, F body) {
+  unsigned long iterations = 1;
+  for (;;) {
+    unsigned long allocs = simAllocCount;
+    unsigned long bytes = simAllocBytes;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+      body();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    if (ns >= BENCH_MIN_TIME * 1e6 || iterations >= (1UL << 30)) {
+      results[resultCount++] = { name, iterations, ns / iterations,
+        (double)(simAllocCount - allocs) / iterations, (double)(simAllocBytes - bytes) / iterations };
+      return;
+    }
+    iterations *= 2;
+  }
+}
+
+// Tâche armée des mesures de l'ordonnanceur
+static void benchTask(void *) {}
+
+// Nombres de timers armés mesurés
+static const unsigned benchTimers[] = { 4, 32, 256 };
+static_assert(MAX_TASK >= 256 + 6, "bench : compiler avec -DMAX_TASK=272 -DTASK_INDEX_BITS=9");
+
+// Noms formatés des mesures, conservés jusqu'à la sortie JSON
+static char names[16][24];
+static int nameCount = 0;
+
+static const char *benchName(const char *format, unsigned count) {
+  char *name = names[nameCount++];
+  snprintf(name, sizeof(names[0]), format, count);
+  return name;
+}
+
+/**
+ * @brief Measures tic() and schedule() with count armed timers, idle then with one expiry per call.
+ *
+ * The firmware tasks are stopped meanwhile so that exactly count timers are in the heap, all with
+ * a period far beyond the measure; for the expiry cases the period of one of them is set to 1 ms.
+ */
+static void benchScheduler(unsigned count) {
+  task_id firmware[] = { idLogFlushTask, idHeapTask, idScheduleCleanTask };
+  boolean armed[3];
+  for (int i = 0; i < 3; i++) {
+    armed[i] = timerTask.getStatus(firmware[i]) == PRET;
+    timerTask.t_stop(firmware[i]);
+  }
+  task_id ids[256];
+  for (unsigned i = 0; i < count; i++) {
+    ids[i] = timerTask.t_creer(benchTask, NULL, 1000000000U, true);
+    timerTask.t_start(ids[i]);
+  }
+
+  bench(benchName("tic_idle_%u", count), [] {
+    Task::tic();
+  });
+  bench(benchName("schedule_idle_%u", count), [] {
+    timerTask.schedule();
+  });
+
+  // Une échéance à chaque appel
+  timerTask.t_stop(ids[0]);
+  timerTask.setInterval(ids[0], 1);
+  timerTask.t_start(ids[0]);
+  bench(benchName("tic_due_%u", count), [] {
+    simMicros += 1000;
+    Task::tic();
+    // Exécution écartée : seule la détection est mesurée
+    readyHead = readyTail;
+  });
+  timerTask.t_stop(ids[0]);
+  timerTask.t_start(ids[0]);
+  bench(benchName("schedule_due_%u", count), [] {
+    simMicros += 1000;
+    timerTask.schedule();
+  });
+
+  for (unsigned i = 0; i < count; i++)
+    timerTask.t_delete(ids[i]);
+  for (int i = 0; i < 3; i++) {
+    if (armed[i])
+      timerTask.t_start(firmware[i]);
+  }
+}
+
+// Topic et message modifiables transmis au callback MQTT, copiés comme le
+// fait PubSubClient dans son buffer (MQTT_MAX_PACKET_SIZE octets au plus)
+static void dispatch(const char *topic, const char *payload,
+    void (*callback)(char *, byte *, unsigned int) = PubSubCallback) {
+  char name[64];
+  char data[MQTT_MAX_PACKET_SIZE];
+  unsigned length = strlen(payload);
+  if (length > sizeof(data))
+    length = sizeof(data);
+  snprintf(name, sizeof(name), "%s", topic);
+  memcpy(data, payload, length);
+  callback(name, (byte *)data, length);
+}
+
+int main(int argc, char **argv) {
+  simReset();
+  simSetEpoch(1748852940UL);
+  setup();
+  // Les enregistrements de la simulation faussent les allocations
+  simRecord = false;
+
+  bench("schedule_idle", [] {
+    timerTask.schedule();
+  });
+
+  // Une échéance à chaque passage : tâche périodique de 1 ms
+  timerTask.setInterval(idLogFlushTask, 1);
+  bench("schedule_due", [] {
+    simMicros += 1000;
+    timerTask.schedule();
+  });
+  timerTask.setInterval(idLogFlushTask, LOG_FLUSH_PERIOD);
+
+  for (unsigned count : benchTimers)
+    benchScheduler(count);
+
+  bench("profile_lap", [] {
+    simMicros += 3;
+    profiler.lap(PS_RELAY, 0);
+  });
+
+  bench("param_parse", [] {
+    Params p;
+    paramParse(tabParam, strlen(tabParam), &p);
+  });
+
+  bench("param_parse_legacy", [] {
+    Params p;
+    legacyParse(tabParam, &p);
+  });
+
+  bench("param_parse_patch", [] {
+    Params p = params;
+    const char *patch = "cycles=120;time=200";
+    paramParsePatch(patch, strlen(patch), &p);
+  });
+
+  bench("param_apply", [] {
+    setParam(&params);
+  });
+
+  bench("param_format", [] {
+    char buffer[48];
+    paramFormat(&params, buffer, sizeof(buffer));
+  });
+
+  bench("dispatch_hit", [] {
+    dispatch(TOPIC_MANUAL, "STOP");
+  });
+
+  bench("dispatch_miss", [] {
+    dispatch(TOPIC_BASE "unknown", "");
+  });
+
+  // Ancienne chaine de strcmp avec copie du message dans un String
+  bench("dispatch_legacy_hit", [] {
+    dispatch(TOPIC_MANUAL, "STOP", legacyDispatch);
+  });
+
+  bench("dispatch_legacy_miss", [] {
+    dispatch(TOPIC_BASE "unknown", "", legacyDispatch);
+  });
+
+  // Messages plus longs que le tampon interne d'un String : l'ancien
+  // callback réalloue en copiant le message caractère par caractère.
+  // Valeurs courantes, rien n'est écrit en flash
+  static char setParam[48];
+  static char patch[64];
+  strcpy(setParam, tabParam);
+  snprintf(patch, sizeof(patch), "cycles=%d;time=%d;avMin=%d;avMax=%d",
+    params.nbCycles, params.activeTime, params.minRandomAv, params.maxRandomAv);
+  bench("dispatch_set_param", [] {
+    dispatch(TOPIC_SET_PARAM, setParam);
+  });
+
+  bench("dispatch_legacy_set_param", [] {
+    dispatch(TOPIC_SET_PARAM, setParam, legacyDispatch);
+  });
+
+  bench("dispatch_patch", [] {
+    dispatch(TOPIC_PATCH_PARAM, patch);
+  });
+
+  bench("dispatch_legacy_patch", [] {
+    dispatch(TOPIC_PATCH_PARAM, patch, legacyDispatch);
+  });
+
+  // Mise en file et envoi
+  bench("publish_state", [] {
+    publishState();
+    outbox.drain();
+  });
+
+  // Passage courant dans loop() : relevé non dû
+  bench("status_update", [] {
+    statusUpdate();
+  });
+
+  bench("log_append", [] {
+    LogRecord record = { 1748852940UL, 2, 0, 0 };
+    logStore.append(&record);
+  });
+
+  // Système de fichiers chargé : BENCH_FILES fichiers en plus de ceux du firmware
+  char name[32];
+  for (unsigned i = 0; i < BENCH_FILES; i++) {
+    sprintf(name, "f%03u.bin", i);
+    File f = LittleFS.open(name, "w");
+    f.write((const uint8_t *)name, strlen(name));
+    f.close();
+  }
+  // Ouvertures de fichiers du boot : paramètres et journal
+  bench("fs_boot", [] {
+    Params p;
+    LogStore store;
+    paramLoad(&p);
+    store.begin(LOG_FILE_NAME);
+  });
+
+  // Fichier classé après les autres dans le répertoire
+  FileLittleFS last("r_param_z.bin");
+  last.writeFile("0", "w");
+  bench("fs_exist", [&last] {
+    last.exist();
+  });
+  bench("fs_exist_legacy", [] {
+    legacyExist("r_param_z.bin");
+  });
+  bench("fs_size", [&last] {
+    last.fileSize();
+  });
+  bench("fs_size_legacy", [] {
+    legacyFileSize("r_param_z.bin");
+  });
+  last.deleteFile();
+  for (unsigned i = 0; i < BENCH_FILES; i++) {
+    sprintf(name, "f%03u.bin", i);
+    LittleFS.remove(name);
+  }
+
+  FileLittleFS file("bench.txt");
+  bench("file_append", [&file] {
+    file.writeFile("02/06/2025 10:30:00 - Start scheduled clean cycle\n", "a");
+    if (file.fileSize() > 64 * 1024)
+      file.deleteFile();
+  });
+
+  // Sortie JSON
+  FILE *out = argc > 1 ? fopen(argv[1], "w") : nullptr;
+  for (FILE *f : { stdout, out }) {
+    if (f == nullptr)
+      continue;
+    fprintf(f, "{\n  \"version\": \"%s\",\n  \"unit\": \"host\",\n  \"benchmarks\": [\n", version);
+    for (int i = 0; i < resultCount; i++) {
+      fprintf(f, "    { \"name\": \"%s\", \"iterations\": %lu, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f }%s\n",
+        results[i].name, results[i].iterations, results[i].nsPerOp, results[i].allocsPerOp, results[i].bytesPerOp,
+        i < resultCount - 1 ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+  }
+  if (out)
+    fclose(out);
+  return 0;
+}
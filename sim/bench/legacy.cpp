@@ -0,0 +1,147 @@
+/**
+ * @file legacy.cpp
+ * @brief Former implementations kept on the host only, as reference points of the benchmarks.
+ *
+ * legacyDispatch() reproduces the MQTT callback replaced by the sorted command table: the payload
+ * is copied into a String and the topic compared with each topic in turn. The commands added
+ * since then are appended to the chain, as the former code would have grown. It calls the same
+ * handlers as PubSubCallback(), so that the difference measured is the dispatch alone.
+ * legacyParse() reproduces the former parameter parser: the string is copied, split by strtok into
+ * fixed items (strcpy) and each item converted by atoi, without any check.
+ * legacyExist() and legacyFileSize() reproduce the former FileLittleFS lookups, which walked the
+ * root directory and compared each name.
+ */
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "const.h"
+#include "params.h"
+
+void onSetParam(const char* payload, unsigned length);
+void onPatchParam(const char* payload, unsigned length);
+void onGetParam(const char*, unsigned);
+void onGetVersion(const char*, unsigned);
+void onGetLogs(const char*, unsigned);
+void onGetStatus(const char*, unsigned);
+void onGetDiag(const char*, unsigned);
+void onSetCalendar(const char* payload, unsigned length);
+void onGetCalendar(const char*, unsigned);
+void onGetProfile(const char* payload, unsigned length);
+void onStart(const char* payload, unsigned length);
+void onManual(const char* payload, unsigned length);
+void onDeleteLogs(const char*, unsigned);
+void onReset(const char*, unsigned);
+
+// Item d'un champ param
+struct Item {
+  char item[5];
+};
+
+/*
+ * Retourne un tableau de PARAM_LEN chaines splittées par motif
+ * Attention str est modifié par la fonction
+ */
+Item* split(char* str, const char* motif) {
+  static Item items[PARAM_LEN + 1];
+  char* pch;
+  pch = strtok(str, motif);
+  int i = 0;
+  while (pch != NULL) {
+    strcpy(items[i++].item, pch);
+    pch = strtok(NULL, motif);
+  }
+  return items;
+}
+
+void legacyParse(const char* tabParam, Params* params) {
+  char temp[50];
+  strcpy(temp, tabParam);
+  Item* paramItem = split(temp, ":");
+  for (int id = 0; id < PARAM_LEN; id++)
+    paramSet(params, id, atoi(paramItem[id].item));
+}
+
+void legacyDispatch(char* topic, byte* payload, unsigned int length) {
+  String strPayload = "";
+
+  for (unsigned int i = 0; i < length; i++) {
+    strPayload += (char)payload[i];
+  }
+  const char* p = strPayload.c_str();
+  unsigned n = strPayload.length();
+
+  if (strcmp(topic, TOPIC_SET_PARAM) == 0) {
+    onSetParam(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_PARAM) == 0) {
+    onGetParam(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_VERSION) == 0) {
+    onGetVersion(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_LOGS) == 0) {
+    onGetLogs(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_STATUS) == 0) {
+    onGetStatus(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_START) == 0) {
+    onStart(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_MANUAL) == 0) {
+    onManual(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_DELETE_LOGS) == 0) {
+    onDeleteLogs(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_RESET) == 0) {
+    onReset(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_PATCH_PARAM) == 0) {
+    onPatchParam(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_DIAG) == 0) {
+    onGetDiag(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_SET_CALENDAR) == 0) {
+    onSetCalendar(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_CALENDAR) == 0) {
+    onGetCalendar(p, n);
+    return;
+  }
+  else if (strcmp(topic, TOPIC_GET_PROFILE) == 0) {
+    onGetProfile(p, n);
+    return;
+  }
+}
+
+boolean legacyExist(const char *path) {
+  Dir dir = LittleFS.openDir("");
+  while (dir.next()) {
+    if (strcmp(dir.fileName().c_str(), path) == 0)
+      return true;
+  }
+  return false;
+}
+
+int legacyFileSize(const char *path) {
+  Dir dir = LittleFS.openDir("");
+  while (dir.next()) {
+    if (strcmp(dir.fileName().c_str(), path) == 0) {
+      return static_cast<int>(dir.fileSize());
+    }
+  }
+  return -1;
+}
@@ -0,0 +1,432 @@
+/**
+ * @file checkMain.cpp
+ * @brief Long-running host tests of the firmware modules (check environment).
+ *
+ * Unlike the session simulation, these tests drive a single module directly on top of the host
+ * HAL, over far more operations than a session produces.
+ * The log store test appends CHECK_LOG_RECORDS records through successive store instances, as
+ * many reboots would, and checks after each of them that the files never exceed the store
+ * capacity, that only the oldest records were dropped, that the current segment is found
+ * again after a reopen and that the whole log is read back in chronological order. A legacy
+ * text log, larger than the store, must be converted into records and deleted at boot. The log
+ * is also read back while records are appended between two lines.
+ * The calendar test drives a weekly calendar over a whole year of a fake UTC clock, both clock
+ * changes included, with late checks and reboots (the last run being kept in RTC memory), and
+ * checks that every slot occurrence starts exactly one run within CALENDAR_CATCH_UP seconds.
+ * The parameter test migrates a former text file holding an out-of-range field, then forces the
+ * defaults after a reboot and checks that they are still loaded at the next one.
+ * A task run long after its deadline must have its lateness recorded saturated by the profiler.
+ *
+ * Usage: pio run -e check && .pio/build/check/program
+ * The exit code is 0 when every check passes.
+ */
+#include <Arduino.h>
+#include <algorithm>
+#include <chrono>
+#include <time.h>
+#include "logStore.h"
+#include "timerTask.h"
+#include "profile.h"
+#include "params.h"
+#include "calendar.h"
+#include "wallClock.h"
+#include "const.h"
+
+// Année du calendrier : du 01/01/2025 00:00 UTC, 365 jours
+#define CHECK_CAL_START 1735689600UL
+#define CHECK_CAL_DAYS  365
+// Créneaux : semaine, week-end, dimanche dans l'heure sautée ou répétée, fin de journée
+#define CHECK_CAL_SLOTS "1111100 07:30;0000011 10:00;0000001 02:30;0010000 23:59"
+// Intervalle maximal entre deux vérifications (corrections d'horloge) en s
+#define CHECK_CAL_STEP  600
+// Retard d'une vérification sur deux cent (boucle bloquée), inférieur à CALENDAR_CATCH_UP
+#define CHECK_CAL_LATE  (CALENDAR_CATCH_UP - 60)
+// Durée d'un redémarrage en s
+#define CHECK_CAL_REBOOT 20
+
+// Ordonnanceur et profil du firmware (main.cpp, profile.cpp)
+extern Task timerTask;
+extern Profiler profiler;
+// Retard imposé à une tâche en ms, au-delà de la limite du profil en µs sur 32 bits
+#define CHECK_LATE_TIME (80 * 60000UL)
+
+// Paramètres du firmware (main.cpp, params.cpp)
+extern Params params;
+extern int paramSlot;
+extern uint16_t paramSequence;
+uint16_t initFileParam(boolean force);
+
+// Enregistrements ajoutés au journal et longueur moyenne d'une session (entre deux ouvertures)
+#define CHECK_LOG_RECORDS 2000000UL
+#define CHECK_LOG_SESSION 5000UL
+// Lignes relues par enregistrement ajouté pendant une relecture
+#define CHECK_LOG_READ_RATE 2
+// Lignes de l'ancien journal texte converties au boot (plus que la capacité)
+#define CHECK_LOG_LEGACY 1500
+// Date du premier enregistrement, une seconde par enregistrement
+#define CHECK_LOG_EPOCH 1748852940UL
+
+static int failures = 0;
+
+static void check(bool condition, const char *message) {
+  if (!condition) {
+    printf("ECHEC : %s\n", message);
+    failures++;
+  }
+}
+
+// Taille totale des segments du journal
+static size_t logSize() {
+  size_t size = 0;
+  char name[32];
+  for (unsigned i = 0; i < LOG_SEGMENTS; i++) {
+    sprintf(name, LOG_SEGMENT_NAME, i);
+    auto it = LittleFS.files.find(name);
+    if (it != LittleFS.files.end())
+      size += it->second->size();
+  }
+  return size;
+}
+
+// Date d'une ligne "jj/mm/aaaa hh:mm:ss - ...", 0 si illisible
+static uint32_t lineEpoch(const char *line) {
+  struct tm t = {};
+  if (sscanf(line, "%d/%d/%d %d:%d:%d", &t.tm_mday, &t.tm_mon, &t.tm_year, &t.tm_hour, &t.tm_min, &t.tm_sec) != 6)
+    return 0;
+  t.tm_mon -= 1;
+  t.tm_year -= 1900;
+  return (uint32_t)timegm(&t);
+}
+
+/**
+ * @brief Reads the whole log back and checks that it holds the latest records, in order.
+ *
+ * @param last Date of the last record written.
+ * @return Number of lines read.
+ */
+static unsigned checkReadback(LogStore &store, uint32_t last) {
+  char line[64];
+  unsigned lines = 0;
+  uint32_t previous = 0;
+  boolean ordered = true;
+  store.openRead();
+  while (store.readLine(line, sizeof(line)) > 0) {
+    uint32_t epoch = lineEpoch(line);
+    // Enregistrements consécutifs : aucun trou, seuls les plus anciens manquent
+    if (lines > 0 && epoch != previous + 1)
+      ordered = false;
+    previous = epoch;
+    lines++;
+  }
+  store.close();
+  check(ordered, "journal relu dans le désordre ou incomplet");
+  check(lines > 0 && previous == last, "derniers enregistrements absents du journal");
+  return lines;
+}
+
+/**
+ * @brief Converts a legacy text log larger than the store, unknown lines included.
+ *
+ * The legacy file must be deleted and the last records read back as their original lines.
+ *
+ * @return Number of lines read back.
+ */
+static unsigned checkLogMigration() {
+  const unsigned capacity = LOG_SEGMENTS * LOG_SEGMENT_SIZE / sizeof(LogRecord);
+  static std::string lines[CHECK_LOG_LEGACY];
+  simReset();
+  std::string text;
+  char line[64];
+  for (unsigned i = 0; i < CHECK_LOG_LEGACY; i++) {
+    LogRecord record = { (uint32_t)(CHECK_LOG_EPOCH + i), (uint8_t)(EV_BOOT + i % 6), 0,
+      (uint16_t)(i % 6 == 0 ? i % 7 : 0) };
+    renderEvent(&record, line, sizeof(line));
+    lines[i] = line;
+    text += line;
+    // Lignes ignorées par la conversion
+    if (i % 97 == 0)
+      text += "02/06/2025 10:29:00 - Unknown message\nligne illisible\n";
+  }
+  LittleFS.files[LOG_FILE_NAME] = std::make_shared<std::string>(text);
+  LogStore store;
+  store.begin(LOG_FILE_NAME);
+  check(LittleFS.files.count(LOG_FILE_NAME) == 0, "ancien journal texte conservé");
+  check(logSize() <= LOG_SEGMENTS * LOG_SEGMENT_SIZE, "taille du journal supérieure à sa capacité");
+  static std::string read[CHECK_LOG_LEGACY];
+  unsigned count = 0;
+  store.openRead();
+  while (count < CHECK_LOG_LEGACY && store.readLine(line, sizeof(line)) > 0)
+    read[count++] = line;
+  store.close();
+  // Les derniers enregistrements, dans l'ordre, rotation comprise
+  boolean same = count > 0;
+  for (unsigned i = 0; i < count; i++)
+    same = same && read[i] == lines[CHECK_LOG_LEGACY - count + i];
+  check(same && count >= capacity - LOG_SEGMENT_SIZE / sizeof(LogRecord), "ancien journal mal converti");
+  printf("ancien journal : %u lignes, %u relues après conversion\n", CHECK_LOG_LEGACY, count);
+  return count;
+}
+
+/**
+ * @brief Reads the log back while records are appended between two lines, as pumpLogs() does
+ * over several loop() passes.
+ *
+ * A first read appends one record every CHECK_LOG_READ_RATE lines, which moves the current
+ * segment twice: every line must follow the previous one, from the oldest record at openRead().
+ * A second read appends a burst larger than the buffer while the oldest segment is being read:
+ * the read must end early, without any gap in the lines read nor in the store.
+ */
+static void checkLogReadWhileAppend() {
+  const unsigned perSegment = LOG_SEGMENT_SIZE / sizeof(LogRecord);
+  simReset();
+  LogStore store;
+  store.begin(LOG_FILE_NAME);
+  unsigned long written = 0;
+  // Trois segments et demi : une rotation attend la fin du segment le plus ancien
+  while (written < (LOG_SEGMENTS - 1) * perSegment + perSegment / 2) {
+    LogRecord record = { (uint32_t)(CHECK_LOG_EPOCH + written++), EV_START_MANUAL, 0, 0 };
+    store.append(&record);
+  }
+  char line[64];
+  for (int pass = 0; pass < 2; pass++) {
+    // Seconde relecture : segment courant plein, la rafale impose une rotation
+    while (pass == 1 && written % perSegment != 0) {
+      LogRecord record = { (uint32_t)(CHECK_LOG_EPOCH + written++), EV_START_MANUAL, 0, 0 };
+      store.append(&record);
+    }
+    store.flush();
+    unsigned lines = 0;
+    uint32_t previous = 0;
+    boolean ordered = true;
+    store.openRead();
+    while (store.readLine(line, sizeof(line)) > 0) {
+      uint32_t epoch = lineEpoch(line);
+      if (lines > 0 && epoch != previous + 1)
+        ordered = false;
+      previous = epoch;
+      lines++;
+      unsigned burst = pass == 0 ? lines % CHECK_LOG_READ_RATE == 0 : lines == 1 ? LOG_BUFFER_LEN + 1 : 0;
+      for (unsigned i = 0; i < burst; i++) {
+        LogRecord record = { (uint32_t)(CHECK_LOG_EPOCH + written++), EV_START_MANUAL, 0, 0 };
+        store.append(&record);
+      }
+      if (lines % 50 == 0)
+        store.flush();
+    }
+    store.close();
+    check(ordered, "journal relu dans le désordre pendant des ajouts");
+    if (pass == 0)
+      check(lines >= LOG_SEGMENTS * perSegment - perSegment / 2, "relecture incomplète pendant des ajouts");
+    else
+      check(lines < perSegment, "relecture non interrompue par un tampon plein");
+    store.flush();
+    checkReadback(store, CHECK_LOG_EPOCH + written - 1);
+    printf("relecture pendant des ajouts : %u lignes, %lu enregistrements ajoutés\n", lines, written);
+  }
+}
+
+/**
+ * @brief Appends CHECK_LOG_RECORDS records over sessions of varying length.
+ *
+ * @return Number of sessions.
+ */
+static unsigned checkLogStore() {
+  const unsigned perSegment = LOG_SEGMENT_SIZE / sizeof(LogRecord);
+  simReset();
+  unsigned long written = 0;
+  unsigned sessions = 0;
+  size_t maxSize = 0;
+  while (written < CHECK_LOG_RECORDS && failures == 0) {
+    LogStore store;
+    store.begin(LOG_FILE_NAME);
+    // L'index doit désigner le segment du dernier enregistrement
+    if (written > 0)
+      check(checkReadback(store, CHECK_LOG_EPOCH + written - 1) >= (LOG_SEGMENTS - 1) * perSegment,
+        "journal perdu à la réouverture");
+    unsigned long length = CHECK_LOG_SESSION + (sessions * 7919UL) % CHECK_LOG_SESSION;
+    for (unsigned long i = 0; i < length && written < CHECK_LOG_RECORDS; i++) {
+      LogRecord record = { (uint32_t)(CHECK_LOG_EPOCH + written), EV_START_MANUAL, 0, 0 };
+      store.append(&record);
+      written++;
+      if (written % 61 == 0) {
+        size_t size = logSize();
+        if (size > maxSize)
+          maxSize = size;
+      }
+    }
+    store.flush();
+    // Compteurs de l'écriture par lot bornés par les enregistrements de la session
+    check(store.getSavedOpens() <= length && store.getSavedBytes() <= length * LOG_COMMIT_BYTES
+      && store.getFlushCount() > 0, "compteurs d'écriture par lot incohérents");
+    unsigned lines = checkReadback(store, CHECK_LOG_EPOCH + written - 1);
+    // Seul le segment le plus ancien est vidé lors d'une rotation
+    check(lines > (LOG_SEGMENTS - 1) * perSegment && lines <= LOG_SEGMENTS * perSegment,
+      "nombre d'enregistrements conservés incorrect");
+    sessions++;
+  }
+  check(written == CHECK_LOG_RECORDS, "ajouts interrompus");
+  check(maxSize <= LOG_SEGMENTS * LOG_SEGMENT_SIZE && logSize() <= LOG_SEGMENTS * LOG_SEGMENT_SIZE,
+    "taille du journal supérieure à sa capacité");
+  printf("journal : %lu enregistrements en %u sessions, %zu octets au plus\n", written, sessions, maxSize);
+  return sessions;
+}
+
+// Première heure UTC à laquelle l'horloge locale atteint local
+static uint32_t firstReach(uint32_t local) {
+  uint32_t u = local - TZ_DST_OFFSET;
+  while (utcToLocal(u) < local)
+    u++;
+  return u;
+}
+
+/**
+ * @brief Runs a weekly calendar over a year and matches each run with a slot occurrence.
+ *
+ * @return Number of runs.
+ */
+static unsigned checkCalendar() {
+  // Occurrences attendues, dans l'ordre
+  static uint32_t expected[CHECK_CAL_DAYS * 3];
+  unsigned count = 0;
+  static const struct { uint8_t days; uint8_t hour; uint8_t minute; } slots[] = {
+    { 0x3e, 7, 30 }, { 0x41, 10, 0 }, { 0x01, 2, 30 }, { 0x08, 23, 59 },
+  };
+  uint32_t end = CHECK_CAL_START + CHECK_CAL_DAYS * 86400UL;
+  for (uint32_t day = utcToLocal(CHECK_CAL_START) / 86400; day * 86400 < utcToLocal(end); day++) {
+    for (auto &slot : slots) {
+      if (!(slot.days & (1 << weekdayFromDays(day))))
+        continue;
+      uint32_t due = firstReach(day * 86400 + slot.hour * 3600UL + slot.minute * 60UL);
+      if (due > CHECK_CAL_START && due < end)
+        expected[count++] = due;
+    }
+  }
+  std::sort(expected, expected + count);
+
+  simReset();
+  static uint32_t runs[CHECK_CAL_DAYS * 3];
+  unsigned runCount = 0;
+  unsigned checks = 0;
+  unsigned reboots = 0;
+  uint32_t now = CHECK_CAL_START;
+  // Redémarrages imposés : dans l'heure répétée juste après le créneau de 02:30 CEST,
+  // juste avant et juste après le passage à l'heure d'été
+  uint32_t forced[] = { dstEnd(2025) - 1800 + 300, dstEnd(2025) + 1200, dstStart(2025) - 600, dstStart(2025) + 30 };
+  while (now < end && runCount < CHECK_CAL_DAYS * 3) {
+    Calendar calendar;
+    calendar.begin();
+    calendar.setDaily(true, 10, 30);
+    check(calendar.parse(CHECK_CAL_SLOTS, strlen(CHECK_CAL_SLOTS)), "calendrier refusé");
+    calendar.plan(now);
+    boolean reboot = false;
+    while (now < end && !reboot) {
+      if (calendar.fire(now))
+        runs[runCount++] = now;
+      checks++;
+      uint32_t wait = calendar.wait(now);
+      if (wait > CHECK_CAL_STEP)
+        wait = CHECK_CAL_STEP;
+      uint32_t next = now + (wait ? wait : 1);
+      if (checks % 200 == 0)
+        next += CHECK_CAL_LATE;
+      for (uint32_t f : forced) {
+        if (now < f && next >= f) {
+          next = f;
+          reboot = true;
+        }
+      }
+      // Redémarrage régulier, et juste après un nettoyage sur cinq
+      if (checks % 97 == 0 || (runCount % 5 == 0 && runCount > 0 && runs[runCount - 1] == now))
+        reboot = true;
+      now = next + (reboot ? CHECK_CAL_REBOOT : 0);
+    }
+    reboots++;
+  }
+
+  // Chaque occurrence démarre un nettoyage et un seul, dans la fenêtre de rattrapage
+  check(runCount >= count, "créneau manqué");
+  check(runCount <= count, "créneau exécuté deux fois");
+  for (unsigned i = 0; i < count && i < runCount; i++) {
+    if (runs[i] < expected[i] || runs[i] - expected[i] > CALENDAR_CATCH_UP) {
+      check(false, "nettoyage hors de la fenêtre de rattrapage de son créneau");
+      break;
+    }
+  }
+  printf("calendrier : %u nettoyages pour %u créneaux sur %u jours, %u vérifications, %u redémarrages\n",
+    runCount, count, CHECK_CAL_DAYS, checks, reboots);
+  return runCount;
+}
+
+// Redémarrage : l'emplacement courant des paramètres est oublié
+static void paramReboot() {
+  paramSlot = -1;
+  paramSequence = 0;
+}
+
+/**
+ * @brief Checks the field by field migration and the forced defaults.
+ */
+static void checkParams() {
+  simReset();
+  paramReboot();
+  // Nombre de cycles hors bornes, les autres champs valides
+  File legacy = LittleFS.open(PARAM_FILE_NAME, "w");
+  legacy.write((const uint8_t *)"1:11:45:40:99:40:99:0:5000:360:1\r\n", 34);
+  legacy.close();
+  uint16_t corrected = initFileParam(false);
+  check(corrected == 1 << P_N_CYCLES, "champs corrigés de l'ancien fichier incorrects");
+  check(params.scheduleH == 11 && params.scheduleM == 45 && params.nbCycles == 1000,
+    "ancien fichier mal migré");
+  check(!LittleFS.exists(PARAM_FILE_NAME), "ancien fichier non supprimé");
+
+  // Plusieurs enregistrements : le plus récent est dans l'un ou l'autre emplacement
+  for (int i = 0; i < 3; i++) {
+    params.scheduleH = 12 + i;
+    paramSave(&params);
+  }
+  paramReboot();
+  initFileParam(true);
+  paramReboot();
+  Params loaded;
+  Params defaults;
+  paramDefaults(&defaults);
+  check(paramLoad(&loaded) && memcmp(&loaded, &defaults, sizeof(Params)) == 0,
+    "valeurs par défaut forcées masquées par un ancien enregistrement");
+}
+
+static void lateTask(void *context) {
+  (*(unsigned *)context)++;
+}
+
+/**
+ * @brief Runs a task CHECK_LATE_TIME ms after its deadline (long blocked loop): its lateness must
+ * be recorded saturated, not wrapped to a small value.
+ */
+static void checkLateness() {
+  unsigned runs = 0;
+  simReset();
+  profiler.reset();
+  task_id id = timerTask.t_creer(lateTask, &runs, 1, false);
+  timerTask.t_start(id);
+  simMicros += CHECK_LATE_TIME * 1000ULL;
+  Task::tic();
+  timerTask.schedule();
+  timerTask.t_delete(id);
+  check(runs == 1, "tâche en retard non exécutée");
+  check(profiler.getMax(PS_TIMER_LATE) == UINT32_MAX, "retard de tâche tronqué");
+  printf("retard : %lu mn, enregistré %lu µs\n", CHECK_LATE_TIME / 60000, (unsigned long)profiler.getMax(PS_TIMER_LATE));
+}
+
+int main() {
+  auto wallStart = std::chrono::steady_clock::now();
+  checkLogMigration();
+  checkLogReadWhileAppend();
+  checkLogStore();
+  checkCalendar();
+  checkParams();
+  checkLateness();
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+  printf("durée : %.1f ms\n", wallMs);
+  printf("%s\n", failures ? "ECHEC" : "OK");
+  return failures ? 1 : 0;
+}
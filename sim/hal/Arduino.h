@@ -0,0 +1,136 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+// Couche d'abstraction minimale de l'API Arduino ESP8266 pour la simulation
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+#include "sim.h"
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH   1
+#define LOW    0
+#define INPUT  0
+#define OUTPUT 1
+#define F_CPU  80000000L
+#define A0     17
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+inline unsigned long millis() {
+  return (uint32_t)(simMicros / 1000);
+}
+inline unsigned long micros() {
+  return (uint32_t)simMicros;
+}
+inline void delay(unsigned long ms) {
+  simAdvance(ms);
+}
+inline void yield() {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+inline int analogRead(uint8_t) {
+  return 0;
+}
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Chaine comme la classe String du core ESP8266 : STRING_SSO caractères
+// dans l'objet, au-delà un tampon sur le tas réalloué à la longueur
+// exacte à chaque ajout (String::reserve de WString.cpp), soit une
+// allocation par caractère ajouté un à un
+#define STRING_SSO 11
+
+class String {
+private:
+  char sso[STRING_SSO + 1];
+  char *heap = nullptr;
+  unsigned len = 0;
+  unsigned capacity = STRING_SSO;
+  void append(const char *c, unsigned n) {
+    if (len + n > capacity) {
+      char *p = new char[len + n + 1];
+      memcpy(p, c_str(), len);
+      memcpy(p + len, c, n);
+      delete[] heap;
+      heap = p;
+      capacity = len + n;
+    }
+    else
+      memmove((heap ? heap : sso) + len, c, n);
+    len += n;
+    (heap ? heap : sso)[len] = 0;
+  }
+public:
+  String() { sso[0] = 0; }
+  String(const char *c) { sso[0] = 0; if (c) append(c, strlen(c)); }
+  String(const std::string &c) { sso[0] = 0; append(c.data(), c.size()); }
+  String(const String &o) { sso[0] = 0; append(o.c_str(), o.len); }
+  String &operator=(const String &o) {
+    if (this != &o) {
+      len = 0;
+      append(o.c_str(), o.len);
+    }
+    return *this;
+  }
+  ~String() { delete[] heap; }
+  const char *c_str() const { return heap ? heap : sso; }
+  unsigned length() const { return len; }
+  String &operator+=(const String &o) { append(o.c_str(), o.len); return *this; }
+  String &operator+=(char c) { append(&c, 1); return *this; }
+  friend String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+  friend String operator+(const String &a, const char *b) { String r(a); r.append(b, strlen(b)); return r; }
+  friend String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+  bool operator==(const String &o) const { return len == o.len && memcmp(c_str(), o.c_str(), len) == 0; }
+};
+
+class IPAddress;
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  size_t print(const char *s);
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(long v);
+  size_t println(const char *s = "");
+  size_t println(const String &s) { return println(s.c_str()); }
+  size_t println(long v);
+  size_t println(const IPAddress &ip);
+  int printf(const char *format, ...);
+};
+extern HardwareSerial Serial;
+
+// Causes de reset (user_interface.h)
+struct rst_info {
+  uint32_t reason;
+};
+enum rst_reason {
+  REASON_DEFAULT_RST, REASON_WDT_RST, REASON_EXCEPTION_RST, REASON_SOFT_WDT_RST,
+  REASON_SOFT_RESTART, REASON_DEEP_SLEEP_AWAKE, REASON_EXT_SYS_RST
+};
+
+class EspClass {
+public:
+  rst_info *getResetInfoPtr();
+  void restart();
+  void wdtFeed() {}
+  uint32_t getCycleCount() { return (uint32_t)(simMicros * 80); }
+  uint32_t getFreeHeap() { return 40000; }
+  uint32_t getMaxFreeBlockSize() { return 30000; }
+  uint8_t getHeapFragmentation() { return 0; }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+};
+extern EspClass ESP;
+#endif
@@ -0,0 +1,12 @@
+#ifndef ARDUINO_OTA_H
+#define ARDUINO_OTA_H
+#include <Arduino.h>
+
+class ArduinoOTAClass {
+public:
+  void setHostname(const char *) {}
+  void begin() {}
+  void handle() {}
+};
+extern ArduinoOTAClass ArduinoOTA;
+#endif
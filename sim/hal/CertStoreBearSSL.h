@@ -0,0 +1,4 @@
+#ifndef CERT_STORE_BEARSSL_H
+#define CERT_STORE_BEARSSL_H
+#include <ESP8266WiFi.h>
+#endif
@@ -0,0 +1,30 @@
+#ifndef ESP8266_WIFI_H
+#define ESP8266_WIFI_H
+#include <Arduino.h>
+#include <IPAddress.h>
+
+enum wl_status_t { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 };
+enum WiFiMode_t { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+enum WiFiSleepType_t { WIFI_NONE_SLEEP, WIFI_LIGHT_SLEEP, WIFI_MODEM_SLEEP };
+
+class ESP8266WiFiClass {
+private:
+  WiFiSleepType_t sleepMode = WIFI_NONE_SLEEP;
+public:
+  bool mode(WiFiMode_t) { return true; }
+  wl_status_t begin(const char *, const char *) { return status(); }
+  int8_t waitForConnectResult(unsigned long = 60000) { return status(); }
+  wl_status_t status() { return simNetwork ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool setHostname(const char *) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  void persistent(bool) {}
+  bool reconnect() { return simNetwork; }
+  IPAddress localIP() { return simNetwork ? IPAddress(192, 168, 1, 141) : IPAddress(); }
+  bool setSleepMode(WiFiSleepType_t type, uint8_t = 0) { sleepMode = type; return true; }
+  WiFiSleepType_t getSleepMode() { return sleepMode; }
+  int hostByName(const char *, IPAddress &ip) { ip = IPAddress(162, 159, 200, 1); return simNetwork; }
+};
+extern ESP8266WiFiClass WiFi;
+
+class WiFiClient {};
+#endif
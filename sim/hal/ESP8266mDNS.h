@@ -0,0 +1,4 @@
+#ifndef ESP8266_MDNS_H
+#define ESP8266_MDNS_H
+#include <ESP8266WiFi.h>
+#endif
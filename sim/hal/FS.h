@@ -0,0 +1,72 @@
+#ifndef FS_H
+#define FS_H
+#include <Arduino.h>
+#include <map>
+#include <memory>
+
+// Système de fichiers en mémoire : chaque fichier est une chaine
+// partagée entre les File ouverts sur lui
+
+typedef std::map<std::string, std::shared_ptr<std::string>> SimFiles;
+
+class File {
+private:
+  std::shared_ptr<std::string> data;
+  size_t pos = 0;
+public:
+  File() {}
+  File(std::shared_ptr<std::string> data, size_t pos) : data(data), pos(pos) {}
+  explicit operator bool() const { return data != nullptr; }
+  bool isDirectory() { return false; }
+  int available() { return data ? (int)(data->size() - pos) : 0; }
+  int read();
+  size_t read(uint8_t *buffer, size_t size);
+  String readString();
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const String &s) { return print(s.c_str()); }
+  bool seek(uint32_t pos);
+  size_t position() { return pos; }
+  size_t size() { return data ? data->size() : 0; }
+  bool truncate(uint32_t size);
+  void flush() {}
+  void close() { data.reset(); pos = 0; }
+};
+
+class Dir {
+private:
+  SimFiles::iterator it;
+  SimFiles::iterator end;
+  bool started = false;
+public:
+  Dir(SimFiles::iterator it, SimFiles::iterator end) : it(it), end(end) {}
+  bool next();
+  String fileName() { return String(it->first); }
+  size_t fileSize() { return it->second->size(); }
+};
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS {
+public:
+  SimFiles files;
+  unsigned mountCount = 0;
+  bool begin() { mountCount++; return true; }
+  void end() {}
+  File open(const char *path, const char *mode);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  Dir openDir(const char *path);
+  bool info(FSInfo &info);
+  bool format() { files.clear(); return true; }
+};
+#endif
@@ -0,0 +1,17 @@
+#ifndef IP_ADDRESS_H
+#define IP_ADDRESS_H
+#include <Arduino.h>
+
+class IPAddress {
+private:
+  uint8_t bytes[4];
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : bytes{a, b, c, d} {}
+  uint8_t operator[](int i) const { return bytes[i]; }
+  String toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return String(buffer);
+  }
+};
+#endif
@@ -0,0 +1,6 @@
+#ifndef LITTLE_FS_H
+#define LITTLE_FS_H
+#include <FS.h>
+
+extern FS LittleFS;
+#endif
@@ -0,0 +1,37 @@
+#ifndef PUB_SUB_CLIENT_H
+#define PUB_SUB_CLIENT_H
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+// Client MQTT simulé : les publications sont enregistrées dans
+// simMessages, simInject() délivre un message aux abonnés
+#define MQTT_KEEPALIVE 15
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char *, uint8_t *, unsigned int)
+
+class PubSubClient {
+private:
+  bool linked = false;
+  uint16_t bufferSize = MQTT_MAX_PACKET_SIZE;
+public:
+  MQTT_CALLBACK_SIGNATURE = nullptr;
+  std::vector<std::string> subscriptions;
+  PubSubClient();
+  PubSubClient(WiFiClient &) : PubSubClient() {}
+  ~PubSubClient();
+  PubSubClient &setServer(const char *, uint16_t) { return *this; }
+  PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE) { this->callback = callback; return *this; }
+  PubSubClient &setSocketTimeout(uint16_t) { return *this; }
+  PubSubClient &setKeepAlive(uint16_t) { return *this; }
+  bool setBufferSize(uint16_t size) { bufferSize = size; return true; }
+  uint16_t getBufferSize() { return bufferSize; }
+  bool connect(const char *id, const char *user = nullptr, const char *pass = nullptr);
+  bool connected() { return linked && simNetwork; }
+  void disconnect() { linked = false; subscriptions.clear(); }
+  int state() { return connected() ? 0 : -1; }
+  bool subscribe(const char *topic);
+  bool publish(const char *topic, const char *payload, bool retained = false);
+  bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+  bool loop() { return connected(); }
+};
+#endif
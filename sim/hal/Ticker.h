@@ -0,0 +1,16 @@
+#ifndef TICKER_H
+#define TICKER_H
+#include <Arduino.h>
+
+// Les Ticker armés sont exécutés par simAdvance() à leur échéance
+class Ticker {
+public:
+  uint32_t period = 0;
+  uint64_t next = 0;
+  void (*callback)() = nullptr;
+  ~Ticker() { detach(); }
+  void attach_ms(uint32_t ms, void (*callback)());
+  void detach();
+  bool active() { return callback != nullptr; }
+};
+#endif
@@ -0,0 +1,27 @@
+#ifndef WIFI_UDP_H
+#define WIFI_UDP_H
+#include <ESP8266WiFi.h>
+
+// Une seule requête en cours, adressée au serveur NTP simulé : la
+// réponse est disponible SIM_NTP_RTT ms après l'envoi, horodatée au
+// milieu de l'aller-retour
+#define SIM_NTP_RTT 40
+
+class WiFiUDP {
+private:
+  uint8_t packet[48];
+  size_t length = 0;
+  uint16_t port = 0;
+  bool replyPending = false;
+  uint64_t replyAt = 0;
+public:
+  uint8_t begin(uint16_t) { return 1; }
+  int beginPacket(IPAddress, uint16_t port) { this->port = port; length = 0; return 1; }
+  size_t write(const uint8_t *buffer, size_t size);
+  int endPacket();
+  int parsePacket();
+  int read(uint8_t *buffer, size_t size);
+  void flush() { replyPending = false; }
+  void stop() {}
+};
+#endif
@@ -0,0 +1,502 @@
+/**
+ * @file hal.cpp
+ * @brief Host implementation of the Arduino/ESP8266 APIs used by the firmware.
+ *
+ * Time is virtual and only moves through delay() and simAdvance(), which also runs the armed
+ * Tickers in deadline order. Pin writes and published MQTT messages are recorded with their
+ * virtual time. LittleFS is an in-memory file system, RTC user memory a plain array. A UDP request
+ * to the NTP port is answered by a simulated server following the virtual time.
+ * The global operator new is replaced to count the dynamic allocations made by the firmware;
+ * the allocations of the HAL stand-ins (recording, in-memory files) are not counted, except the
+ * file descriptor that LittleFS allocates on each open, which is charged to the firmware.
+ */
+#include <Arduino.h>
+#include <ArduinoOTA.h>
+#include <ESP8266WiFi.h>
+#include <LittleFS.h>
+#include <WiFiUdp.h>
+#include <PubSubClient.h>
+#include <Ticker.h>
+#include <algorithm>
+#include <new>
+
+uint64_t simMicros = 0;
+std::vector<SimPinEvent> simPinEvents;
+std::vector<SimMessage> simMessages;
+bool simNetwork = true;
+int32_t simClockDrift = 0;
+bool simSerial = false;
+bool simRestart = false;
+bool simRecord = true;
+unsigned long simAllocCount = 0;
+unsigned long simAllocBytes = 0;
+unsigned long simOpenCount = 0;
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+ArduinoOTAClass ArduinoOTA;
+FS LittleFS;
+
+static uint32_t simEpoch = 0;
+static uint8_t pins[32];
+static uint32_t rtcMemory[128];
+static rst_info resetInfo = { REASON_DEFAULT_RST };
+
+// Ticker et clients MQTT sont des objets globaux du firmware, construits
+// et détruits hors de main() : listes créées au premier usage et jamais détruites
+static std::vector<Ticker *> &tickers() {
+  static std::vector<Ticker *> *list = new std::vector<Ticker *>;
+  return *list;
+}
+
+static std::vector<PubSubClient *> &clients() {
+  static std::vector<PubSubClient *> *list = new std::vector<PubSubClient *>;
+  return *list;
+}
+
+//------------------ Allocations ----------------
+
+// operator new s'appuie sur malloc, la libération par free est correcte
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+// Profondeur des appels internes de la couche, dont les allocations
+// (enregistrements, fichiers en mémoire) ne sont pas imputées au firmware
+static int halDepth = 0;
+
+struct HalScope {
+  HalScope() { halDepth++; }
+  ~HalScope() { halDepth--; }
+};
+
+void *operator new(size_t size) {
+  if (halDepth == 0) {
+    simAllocCount++;
+    simAllocBytes += size;
+  }
+  void *p = malloc(size ? size : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  free(p);
+}
+
+//------------------ Temps virtuel ----------------
+
+/**
+ * @brief Advances the virtual time by ms, running the Tickers that expire meanwhile.
+ */
+void simAdvance(uint32_t ms) {
+  uint64_t end = simMicros + ms * 1000ULL;
+  for (;;) {
+    Ticker *first = nullptr;
+    for (Ticker *t : tickers()) {
+      if (t->next <= end && (first == nullptr || t->next < first->next))
+        first = t;
+    }
+    if (first == nullptr)
+      break;
+    simMicros = first->next;
+    first->next += first->period * 1000ULL;
+    first->callback();
+  }
+  simMicros = end;
+}
+
+/**
+ * @brief Sets the UTC epoch corresponding to the current virtual time.
+ */
+void simSetEpoch(uint32_t utc) {
+  simEpoch = utc - (uint32_t)(simMicros / 1000000);
+}
+
+void Ticker::attach_ms(uint32_t ms, void (*callback)()) {
+  HalScope scope;
+  detach();
+  period = ms ? ms : 1;
+  next = simMicros + period * 1000ULL;
+  this->callback = callback;
+  tickers().push_back(this);
+}
+
+void Ticker::detach() {
+  if (callback == nullptr)
+    return;
+  std::vector<Ticker *> &list = tickers();
+  list.erase(std::remove(list.begin(), list.end(), this), list.end());
+  callback = nullptr;
+}
+
+//------------------ Broches ----------------
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  value = value ? HIGH : LOW;
+  if (pin < sizeof(pins) && pins[pin] == value)
+    return;
+  if (pin < sizeof(pins))
+    pins[pin] = value;
+  HalScope scope;
+  if (simRecord)
+    simPinEvents.push_back({ (uint32_t)millis(), pin, value, WiFi.getSleepMode() == WIFI_NONE_SLEEP });
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < sizeof(pins) ? pins[pin] : LOW;
+}
+
+int simPin(uint8_t pin) {
+  return digitalRead(pin);
+}
+
+//------------------ Divers ----------------
+
+static uint32_t randomState = 1;
+
+long random(long max) {
+  // Générateur congruentiel : séquence reproductible d'une simulation à l'autre
+  randomState = randomState * 1103515245 + 12345;
+  return max > 0 ? (long)((randomState >> 1) % (uint32_t)max) : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  randomState = seed ? seed : 1;
+}
+
+size_t HardwareSerial::print(const char *s) {
+  if (simSerial)
+    fputs(s, stdout);
+  return strlen(s);
+}
+
+size_t HardwareSerial::print(long v) {
+  char buffer[24];
+  snprintf(buffer, sizeof(buffer), "%ld", v);
+  return print(buffer);
+}
+
+size_t HardwareSerial::println(const char *s) {
+  return print(s) + print("\n");
+}
+
+size_t HardwareSerial::println(long v) {
+  return print(v) + print("\n");
+}
+
+// Comme Print::println(const Printable &) : pas de String intermédiaire
+size_t HardwareSerial::println(const IPAddress &ip) {
+  char buffer[16];
+  snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+  return println(buffer);
+}
+
+int HardwareSerial::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int n = simSerial ? vprintf(format, args) : vsnprintf(nullptr, 0, format, args);
+  va_end(args);
+  return n;
+}
+
+rst_info *EspClass::getResetInfoPtr() {
+  return &resetInfo;
+}
+
+void EspClass::restart() {
+  simRestart = true;
+  resetInfo.reason = REASON_SOFT_RESTART;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size) {
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy(data, (uint8_t *)rtcMemory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size) {
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy((uint8_t *)rtcMemory + offset * 4, data, size);
+  return true;
+}
+
+/**
+ * @brief Clears the recorded events, the file system and the RTC memory (cold boot).
+ */
+void simReset() {
+  simMicros = 0;
+  simEpoch = 0;
+  simPinEvents.clear();
+  simMessages.clear();
+  simNetwork = true;
+  simClockDrift = 0;
+  simRestart = false;
+  simRecord = true;
+  memset(pins, 0, sizeof(pins));
+  memset(rtcMemory, 0, sizeof(rtcMemory));
+  resetInfo.reason = REASON_DEFAULT_RST;
+  LittleFS.files.clear();
+  randomSeed(1);
+}
+
+//------------------ NTP ----------------
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  size = std::min(size, sizeof(packet) - length);
+  memcpy(packet + length, buffer, size);
+  length += size;
+  return size;
+}
+
+/**
+ * @brief Sends the packet; a request to the NTP port gets a reply SIM_NTP_RTT ms later.
+ */
+int WiFiUDP::endPacket() {
+  if (!simNetwork)
+    return 0;
+  replyPending = port == 123 && length == sizeof(packet) && simEpoch != 0;
+  replyAt = simMicros + SIM_NTP_RTT * 1000ULL;
+  if (!replyPending)
+    return 1;
+  // Heure du serveur au milieu de l'aller-retour, millis() dérivant de simClockDrift ppm
+  uint64_t local = simMicros + SIM_NTP_RTT * 500ULL;
+  uint64_t utc = (uint64_t)simEpoch * 1000000ULL + local + (int64_t)local * simClockDrift / 1000000;
+  uint32_t seconds = (uint32_t)(utc / 1000000) + 2208988800UL;
+  uint32_t fraction = (uint32_t)(((utc % 1000000) << 32) / 1000000);
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x24;   // LI 0, version 4, mode serveur
+  packet[1] = 2;      // strate
+  for (int i = 0; i < 4; i++) {
+    packet[40 + i] = seconds >> (24 - 8 * i);
+    packet[44 + i] = fraction >> (24 - 8 * i);
+  }
+  return 1;
+}
+
+int WiFiUDP::parsePacket() {
+  if (!replyPending || simMicros < replyAt)
+    return 0;
+  // Réponse perdue pendant une coupure
+  if (!simNetwork) {
+    replyPending = false;
+    return 0;
+  }
+  return sizeof(packet);
+}
+
+int WiFiUDP::read(uint8_t *buffer, size_t size) {
+  if (parsePacket() == 0)
+    return 0;
+  size = std::min(size, sizeof(packet));
+  memcpy(buffer, packet, size);
+  replyPending = false;
+  return size;
+}
+
+//------------------ MQTT ----------------
+
+PubSubClient::PubSubClient() {
+  clients().push_back(this);
+}
+
+PubSubClient::~PubSubClient() {
+  std::vector<PubSubClient *> &list = clients();
+  list.erase(std::remove(list.begin(), list.end(), this), list.end());
+}
+
+bool PubSubClient::connect(const char *, const char *, const char *) {
+  HalScope scope;
+  subscriptions.clear();
+  linked = simNetwork;
+  return linked;
+}
+
+bool PubSubClient::subscribe(const char *topic) {
+  HalScope scope;
+  if (!connected())
+    return false;
+  subscriptions.push_back(topic);
+  return true;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained) {
+  return publish(topic, (const uint8_t *)payload, strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained) {
+  // Même limite que la bibliothèque : en-tête, topic et message dans le buffer
+  if (!connected() || 5 + 2 + strlen(topic) + length > bufferSize)
+    return false;
+  HalScope scope;
+  if (simRecord)
+    simMessages.push_back({ (uint32_t)millis(), topic, std::string((const char *)payload, length), retained });
+  return true;
+}
+
+/**
+ * @brief Delivers a message to every connected client subscribed to topic.
+ */
+void simInject(const char *topic, const char *payload) {
+  halDepth++;
+  std::string data(payload);
+  halDepth--;
+  for (PubSubClient *client : clients()) {
+    if (!client->connected() || client->callback == nullptr)
+      continue;
+    if (std::find(client->subscriptions.begin(), client->subscriptions.end(), topic) == client->subscriptions.end())
+      continue;
+    char name[128];
+    snprintf(name, sizeof(name), "%s", topic);
+    client->callback(name, (uint8_t *)&data[0], data.size());
+  }
+}
+
+//------------------ LittleFS ----------------
+
+int File::read() {
+  if (!data || pos >= data->size())
+    return -1;
+  return (uint8_t)(*data)[pos++];
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  if (!data)
+    return 0;
+  size_t n = std::min(size, data->size() - pos);
+  memcpy(buffer, data->data() + pos, n);
+  pos += n;
+  return n;
+}
+
+String File::readString() {
+  if (!data)
+    return String();
+  std::string s = data->substr(pos);
+  pos = data->size();
+  return String(s);
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  HalScope scope;
+  if (!data)
+    return 0;
+  if (pos > data->size())
+    data->resize(pos);
+  data->replace(pos, std::min(size, data->size() - pos), (const char *)buffer, size);
+  pos += size;
+  return size;
+}
+
+bool File::seek(uint32_t pos) {
+  if (!data || pos > data->size())
+    return false;
+  this->pos = pos;
+  return true;
+}
+
+bool File::truncate(uint32_t size) {
+  HalScope scope;
+  if (!data)
+    return false;
+  data->resize(size);
+  if (pos > size)
+    pos = size;
+  return true;
+}
+
+bool Dir::next() {
+  if (started && it != end)
+    ++it;
+  started = true;
+  return it != end;
+}
+
+// Descripteur alloué sur le tas par LittleFS à chaque ouverture réussie
+// (LittleFSFileImpl ou LittleFSDirImpl et le bloc de contrôle du shared_ptr)
+#define SIM_FILE_ALLOC 64
+
+static void chargeOpen() {
+  simOpenCount++;
+  simAllocCount++;
+  simAllocBytes += SIM_FILE_ALLOC;
+}
+
+/**
+ * @brief Opens a file with the stdio modes used by the firmware ("r", "r+", "w", "a").
+ *
+ * A successful open is charged to the firmware as one allocation, as on the target.
+ */
+File FS::open(const char *path, const char *mode) {
+  HalScope scope;
+  auto it = files.find(path);
+  if (mode[0] == 'r') {
+    if (it == files.end())
+      return File();
+    chargeOpen();
+    return File(it->second, 0);
+  }
+  if (it == files.end() || mode[0] == 'w')
+    files[path] = std::make_shared<std::string>();
+  std::shared_ptr<std::string> data = files[path];
+  chargeOpen();
+  return File(data, mode[0] == 'a' ? data->size() : 0);
+}
+
+Dir FS::openDir(const char *) {
+  chargeOpen();
+  return Dir(files.begin(), files.end());
+}
+
+bool FS::exists(const char *path) {
+  HalScope scope;
+  return files.count(path) > 0;
+}
+
+bool FS::remove(const char *path) {
+  HalScope scope;
+  return files.erase(path) > 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  HalScope scope;
+  auto it = files.find(from);
+  if (it == files.end())
+    return false;
+  std::shared_ptr<std::string> data = it->second;
+  files.erase(it);
+  files[to] = data;
+  return true;
+}
+
+bool FS::info(FSInfo &info) {
+  size_t used = 0;
+  for (auto &f : files)
+    used += f.second->size();
+  info = { 1024 * 1024, used, 8192, 256, 5, 32 };
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef SIM_H
+#define SIM_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Contrôle de la simulation (environnement native)
+//
+// Le temps est virtuel : millis(), micros() et ESP.getCycleCount()
+// sont déduits de simMicros, qui n'avance que par delay() et
+// simAdvance(). simAdvance() exécute les Ticker arrivés à échéance.
+// Les écritures sur les broches et les messages MQTT publiés sont
+// enregistrés avec leur date pour être vérifiés par le scénario.
+// Les allocations dynamiques sont comptées (simAllocCount, simAllocBytes),
+// ainsi que les ouvertures de fichier (simOpenCount).
+
+struct SimPinEvent {
+  uint32_t time;     // ms
+  uint8_t pin;
+  uint8_t value;
+  bool awake;        // WiFi hors veille
+};
+
+struct SimMessage {
+  uint32_t time;     // ms
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+extern uint64_t simMicros;
+extern std::vector<SimPinEvent> simPinEvents;
+extern std::vector<SimMessage> simMessages;
+// Réseau disponible (WiFi, courtier MQTT, serveur NTP)
+extern bool simNetwork;
+// Retard de millis() sur l'heure du serveur NTP en ppm (dérive de l'oscillateur)
+extern int32_t simClockDrift;
+// Traces Serial sur la sortie standard
+extern bool simSerial;
+// ESP.restart() appelé
+extern bool simRestart;
+// Enregistrement des broches et des messages (désactivé par les mesures)
+extern bool simRecord;
+// Allocations dynamiques du firmware depuis le lancement (operator new)
+// Les allocations internes de la couche de simulation ne sont pas comptées,
+// sauf le descripteur que LittleFS alloue à chaque ouverture de fichier ou
+// de répertoire (SIM_FILE_ALLOC octets), imputé au firmware
+extern unsigned long simAllocCount;
+extern unsigned long simAllocBytes;
+// Ouvertures de fichier ou de répertoire réussies
+extern unsigned long simOpenCount;
+
+void simAdvance(uint32_t ms);
+void simSetEpoch(uint32_t utc);
+int simPin(uint8_t pin);
+void simInject(const char *topic, const char *payload);
+void simReset();
+#endif
@@ -0,0 +1,8 @@
+// Identifiants factices de l'environnement de simulation
+#define SSID          "sim"
+#define PASSWORD      "sim"
+#define MQTT_SERVER   "localhost"
+#define MQTT_USER     ""
+#define MQTT_PASSWORD ""
+#define PREFIX        "_SIM"
+#define MQTT_PORT     1883
@@ -0,0 +1,309 @@
+/**
+ * @file simMain.cpp
+ * @brief Host simulation of a full scheduled cleaning session (native environment).
+ *
+ * The firmware setup() and loop() run unchanged on top of the host HAL (sim/hal) with a virtual
+ * clock. When a pass of loop() did not consume any time, the clock jumps to the next task
+ * deadline (10 ms steps while the relays are sequencing), so a 360-minute session runs in a
+ * fraction of a second. The recorded relay transitions and MQTT messages are then checked:
+ * the two relays are never energized together, a direction change always waits for the dead
+ * time, the cycle starts at the scheduled time and ends after nbCycles movements, none of the
+ * movement messages being lost over a network outage during the cycle. The retained
+ * status frames are published on change only, STATUS_MIN_INTERVAL ms apart at least, and no
+ * more often than the movements and the minutes of the cycle. The drift
+ * of the millis() time base against the simulated NTP server is measured to the ppm. The
+ * firmware must neither allocate memory nor open a file during the cycle; the commands that
+ * open files (log read back, parameters and calendar saved) may only allocate their file
+ * descriptors. The diagnostic and profile replies, requested together, must not overflow the
+ * outbound queue.
+ * A long run of task creations and deletions then checks that the scheduler pool neither leaks
+ * slots nor accepts a stale task identifier.
+ *
+ * Usage: pio run -e native && .pio/build/native/program [-v]
+ * The exit code is 0 when every check passes.
+ */
+#include <Arduino.h>
+#include <chrono>
+#include "timerTask.h"
+#include "relay.h"
+#include "params.h"
+#include "const.h"
+#include "status.h"
+#include "outbox.h"
+#include "profile.h"
+#include "wallClock.h"
+
+// Objets et fonctions du firmware (main.cpp)
+extern Task timerTask;
+extern Relay relay;
+extern Params params;
+extern Outbox outbox;
+extern WallClock wallClock;
+void setup();
+void loop();
+
+// Pas maximal du temps virtuel et pas pendant le séquencement des relais en ms
+#define SIM_MAX_STEP   1000
+#define SIM_RELAY_STEP 10
+// 02/06/2025 08:29:00 UTC, soit 10:29 CEST, une minute avant le créneau par défaut
+#define SIM_START_EPOCH 1748852940UL
+// Coupure du réseau pendant le cycle : début après le démarrage et durée en ms
+#define SIM_OUTAGE_START 1800000UL
+#define SIM_OUTAGE_TIME  90000UL
+// Retard de millis() sur l'heure NTP en ppm, mesuré par wallClock
+#define SIM_CLOCK_DRIFT 50
+// Trames d'état hors mouvements et minutes du cycle (démarrage, fin, coupure)
+#define SIM_STATUS_EXTRA 10
+// Créations/suppressions de tâches de l'essai de l'ordonnanceur
+#define SIM_POOL_CYCLES 100000
+
+static unsigned long loops = 0;
+static int failures = 0;
+
+static void check(bool condition, const char *message) {
+  if (!condition) {
+    printf("ECHEC : %s\n", message);
+    failures++;
+  }
+}
+
+/**
+ * @brief Runs one pass of loop() and moves the virtual clock to the next event.
+ */
+static void step() {
+  uint64_t before = simMicros;
+  loop();
+  loops++;
+  if (simMicros != before)
+    return;
+  unsigned wait = timerTask.idleTime();
+  if (relay.getState() != relay.getRequest() && wait > SIM_RELAY_STEP)
+    wait = SIM_RELAY_STEP;
+  if (wait > SIM_MAX_STEP)
+    wait = SIM_MAX_STEP;
+  simAdvance(wait ? wait : 1);
+}
+
+// Index du dernier message publié sur topic depuis first, -1 si absent
+static int findMessage(const char *topic, size_t first = 0) {
+  for (size_t i = first; i < simMessages.size(); i++) {
+    if (simMessages[i].topic == topic)
+      return i;
+  }
+  return -1;
+}
+
+static size_t countMessages(const char *topic) {
+  size_t n = 0;
+  for (const SimMessage &m : simMessages)
+    n += m.topic == topic;
+  return n;
+}
+
+/**
+ * @brief Checks the status frames: retained, changed and spaced by STATUS_MIN_INTERVAL.
+ *
+ * @return Number of frames.
+ */
+static unsigned checkStatus() {
+  const SimMessage *previous = nullptr;
+  unsigned frames = 0;
+  for (const SimMessage &m : simMessages) {
+    if (m.topic != TOPIC_STATE)
+      continue;
+    frames++;
+    check(m.retained, "trame d'état non retenue");
+    if (previous != nullptr) {
+      check(m.time - previous->time >= STATUS_MIN_INTERVAL, "trames d'état trop rapprochées");
+      check(m.payload != previous->payload, "trame d'état inchangée republiée");
+    }
+    previous = &m;
+  }
+  check(previous != nullptr && previous->payload.find("cycle=0/") == 0
+    && previous->payload.find(";run=0;") != std::string::npos, "trame d'état finale incorrecte");
+  return frames;
+}
+
+static void countTask(void *context) {
+  (*(unsigned *)context)++;
+}
+
+/**
+ * @brief Creates, runs and deletes SIM_POOL_CYCLES tasks next to the firmware tasks.
+ *
+ * The identifier of the previous task, whose slot is reused, must be rejected by every call;
+ * the number of tasks in use must be back to its initial value, without any allocation.
+ *
+ * @return Number of executions of the test tasks.
+ */
+static unsigned checkTaskPool() {
+  unsigned runs = 0;
+  unsigned used = timerTask.getTaskCount();
+  unsigned long allocs = simAllocCount;
+  task_id previous = TASK_NONE;
+  for (unsigned i = 0; i < SIM_POOL_CYCLES; i++) {
+    task_id id = timerTask.t_creer(countTask, &runs, 1 + i % 5, i % 2);
+    if (id == TASK_NONE || id == previous) {
+      check(false, "emplacement de tâche non libéré");
+      break;
+    }
+    timerTask.t_start(id);
+    // Identifiant périmé : sans effet sur la tâche qui réutilise l'emplacement
+    timerTask.t_stop(previous);
+    timerTask.t_delete(previous);
+    if (timerTask.getStatus(previous) != N_CREE || timerTask.getStatus(id) != PRET) {
+      check(false, "identifiant de tâche périmé accepté");
+      break;
+    }
+    if (i % 3 == 0)
+      step();
+    timerTask.t_delete(id);
+    previous = id;
+  }
+  check(timerTask.getTaskCount() == used, "fuite d'emplacements de tâches");
+  check(simAllocCount == allocs, "allocation dynamique par l'ordonnanceur");
+  check(runs > 0, "tâches de l'essai non exécutées");
+  return runs;
+}
+
+/**
+ * @brief Checks the relay transitions: exclusive outputs, dead time and WiFi awake before each
+ * start.
+ *
+ * @return Number of motor starts.
+ */
+static unsigned checkRelays() {
+  // Sorties actives à l'état bas, HIGH au repos
+  int level[2] = { HIGH, HIGH };
+  uint32_t offTime[2] = { 0, 0 };
+  unsigned starts = 0;
+  for (const SimPinEvent &e : simPinEvents) {
+    int i = e.pin == GPIO2_FORWARD ? 0 : e.pin == GPIO0_RETURN ? 1 : -1;
+    if (i < 0)
+      continue;
+    if (level[i] == HIGH && e.value == LOW) {
+      starts++;
+      check(level[1 - i] == HIGH, "relais avance et recul actifs simultanément");
+      check(e.awake, "moteur démarré WiFi en veille");
+      if (offTime[1 - i] != 0)
+        check(e.time - offTime[1 - i] >= RELAY_DEAD_TIME, "temps mort non respecté");
+    }
+    if (level[i] == LOW && e.value == HIGH)
+      offTime[i] = e.time;
+    level[i] = e.value;
+  }
+  return starts;
+}
+
+int main(int argc, char **argv) {
+  simSerial = argc > 1 && strcmp(argv[1], "-v") == 0;
+  auto wallStart = std::chrono::steady_clock::now();
+
+  simReset();
+  simSetEpoch(SIM_START_EPOCH);
+  simClockDrift = SIM_CLOCK_DRIFT;
+  setup();
+  // Aucune allocation dynamique ni ouverture de fichier n'est permise
+  // pendant le cycle
+  unsigned long setupAllocs = simAllocCount;
+  unsigned long allocs = simAllocCount;
+  unsigned long opens = simOpenCount;
+
+  // Session programmée : jusqu'à la fin du cycle ou activeTime + 10 minutes
+  uint32_t limit = millis() + (params.activeTime + 10) * 60000UL;
+  int scheduled = -1;
+  int end = -1;
+  uint32_t outage = 0;
+  while (millis() < limit && end < 0) {
+    // Seuls les messages publiés par ce passage sont examinés
+    size_t first = simMessages.size();
+    // Coupure du réseau : les messages attendent la reconnexion
+    if (scheduled >= 0 && outage == 0 && millis() - simMessages[scheduled].time >= SIM_OUTAGE_START) {
+      outage = millis();
+      simNetwork = false;
+    }
+    if (!simNetwork && millis() - outage >= SIM_OUTAGE_TIME)
+      simNetwork = true;
+    step();
+    if (scheduled < 0)
+      scheduled = findMessage(TOPIC_SCHEDULED, first);
+    else
+      end = findMessage(TOPIC_RESET_CYCLE, first);
+  }
+  // Dernière trame d'état après la fin du cycle
+  for (uint32_t until = millis() + STATUS_MIN_INTERVAL + STATUS_CHECK_PERIOD; millis() < until;)
+    step();
+  unsigned long runAllocs = simAllocCount - allocs;
+  unsigned long runOpens = simOpenCount - opens;
+  // Commandes ouvrant des fichiers : relecture du journal, enregistrement
+  // des paramètres et du calendrier. Chaque ouverture alloue un descripteur,
+  // aucune autre allocation n'est permise
+  allocs = simAllocCount;
+  opens = simOpenCount;
+  size_t logsFrom = simMessages.size();
+  simInject(TOPIC_GET_LOGS, "");
+  for (int i = 0; i < 1000 && simMessages.back().payload != "#####"; i++)
+    step();
+  simInject(TOPIC_PATCH_PARAM, "min=31");
+  step();
+  simInject(TOPIC_SET_CALENDAR, "");
+  step();
+  // Réponses en plusieurs messages demandées ensemble : aucune perte
+  simInject(TOPIC_GET_DIAG, "");
+  simInject(TOPIC_GET_PROFILE, "");
+  for (int i = 0; i < 100 && countMessages(TOPIC_PROFILE) < PROFILE_SECTIONS; i++)
+    step();
+  unsigned long commandAllocs = simAllocCount - allocs;
+  unsigned long commandOpens = simOpenCount - opens;
+  std::string logs;
+  for (size_t i = logsFrom; i < simMessages.size(); i++) {
+    if (simMessages[i].topic == TOPIC_READ_LOGS)
+      logs += simMessages[i].payload;
+  }
+
+  check(runAllocs == 0, "allocation dynamique pendant le cycle");
+  check(runOpens == 0, "ouverture de fichier pendant le cycle");
+  check(commandOpens > 0 && commandAllocs == commandOpens, "allocation dynamique par une commande");
+  double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wallStart).count();
+  unsigned starts = checkRelays();
+  size_t movements = countMessages(TOPIC_CYCLE_TIME);
+  unsigned frames = checkStatus();
+  unsigned long sessionLoops = loops;
+  unsigned poolRuns = checkTaskPool();
+
+  check(scheduled >= 0, "cycle programmé non démarré");
+  if (scheduled >= 0)
+    check(simMessages[scheduled].payload == "10:30\r", "heure de démarrage incorrecte");
+  check(end >= 0, "cycle non terminé");
+  check(movements == (size_t)params.nbCycles, "nombre de mouvements différent de nbCycles");
+  // Pas de démarrage lorsque l'inversion de mi-cycle garde le même sens,
+  // le dernier mouvement est annulé pendant le temps mort par l'arrêt final
+  check(starts + 2 == movements, "nombre de démarrages moteur incohérent");
+  check(outage != 0, "coupure du réseau non simulée");
+  check(wallClock.getSyncInterval() > 0 && labs(wallClock.getDrift() - SIM_CLOCK_DRIFT) <= 1,
+    "dérive de l'horloge mal mesurée");
+  check(outbox.getDrops() == 0 && outbox.getDepth() == 0, "messages MQTT perdus");
+  check(countMessages(TOPIC_DIAG) >= DIAG_LINES - 1 && countMessages(TOPIC_PROFILE) == PROFILE_SECTIONS,
+    "diagnostic ou profil incomplet");
+  check(logs.find("Start scheduled clean cycle") != std::string::npos, "log de démarrage absent");
+  check(logs.find("End count cycle") != std::string::npos, "log de fin absent");
+
+  unsigned duration = 0;
+  if (scheduled >= 0 && end >= 0)
+    duration = (simMessages[end].time - simMessages[scheduled].time) / 1000;
+  // Une trame par mouvement et par minute de cycle au plus, plus celles du début et de la fin
+  check(frames <= movements + duration / 60 + SIM_STATUS_EXTRA, "trames d'état sans changement d'état");
+  printf("session : %u min %u s virtuelles en %.1f ms (%lu passages dans loop)\n",
+    duration / 60, duration % 60, wallMs, sessionLoops);
+  printf("mouvements : %zu, démarrages moteur : %u, transitions relais : %zu, messages MQTT : %zu\n",
+    movements, starts, simPinEvents.size(), simMessages.size());
+  printf("trames d'état : %u, file MQTT : %u au plus, %lu envoyés, %u remplacés\n",
+    frames, outbox.getMaxDepth(), outbox.getSent(), outbox.getCoalesced());
+  printf("horloge : dérive %ld ppm, correction %ld ms sur %lu s\n",
+    wallClock.getDrift(), wallClock.getLastCorrection(), wallClock.getSyncInterval() / 1000);
+  printf("ordonnanceur : %u créations/suppressions, %u exécutions\n", SIM_POOL_CYCLES, poolRuns);
+  printf("allocations : %lu pendant setup(), %lu pendant le cycle, %lu pour %lu ouvertures de fichier sur commande\n",
+    setupAllocs, runAllocs, commandAllocs, commandOpens);
+  printf("%s\n", failures ? "ECHEC" : "OK");
+  return failures ? 1 : 0;
+}
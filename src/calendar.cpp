@@ -0,0 +1,210 @@
+/**
+ * @file calendar.cpp
+ * @brief Weekly cleaning calendar computing the exact time of the next run.
+ *
+ * next() returns the first slot occurrence strictly after a given local time by looking at the
+ * eight following days of every slot. plan() starts this search from the last run, or from
+ * CALENDAR_CATCH_UP seconds ago when the last run is older, so that a missed slot is found again.
+ * fire() is called when the timer expires: it reports whether the planned run must start and plans
+ * the next one from the current time, so one slot never starts two runs.
+ * The current time and the last run are UTC: the due instant of a slot is the first instant the
+ * local clock reaches it (localToUtc()), so waits and lateness do not jump by an hour when the
+ * clock changes.
+ */
+#include "calendar.h"
+#include "wallClock.h"
+
+Calendar::Calendar() {
+  count = 0;
+  enabled = false;
+  daily.days = ALL_DAYS;
+  daily.hour = 0;
+  daily.minute = 0;
+  lastRun = 0;
+  nextRun = 0;
+}
+
+/**
+ * @brief Restores the time of the last run left in RTC user memory by the previous run.
+ */
+void Calendar::begin() {
+  uint32_t data[2];
+  if (ESP.rtcUserMemoryRead(CALENDAR_RTC_OFFSET, data, sizeof(data)) && data[0] == CALENDAR_RTC_MAGIC)
+    lastRun = data[1];
+}
+
+void Calendar::rtcSave() {
+  uint32_t data[2] = { CALENDAR_RTC_MAGIC, lastRun };
+  ESP.rtcUserMemoryWrite(CALENDAR_RTC_OFFSET, data, sizeof(data));
+}
+
+/**
+ * @brief Sets the daily slot of the parameters, used when the calendar is empty.
+ *
+ * @param enabled Enables the whole calendar.
+ */
+void Calendar::setDaily(boolean enabled, int hour, int minute) {
+  this->enabled = enabled;
+  daily.hour = hour;
+  daily.minute = minute;
+}
+
+/**
+ * @brief Replaces the slots with the ones described by text ("1111100 08:30;...").
+ *
+ * An empty text clears the calendar. The calendar is unchanged if a slot is invalid.
+ *
+ * @return false if the text is invalid.
+ */
+boolean Calendar::parse(const char *text, unsigned length) {
+  CalendarSlot parsed[CALENDAR_SLOTS];
+  unsigned n = 0;
+  unsigned i = 0;
+  while (i < length) {
+    if (n == CALENDAR_SLOTS || length - i < 13)
+      return false;
+    CalendarSlot slot = { 0, 0, 0 };
+    // Lundi..samedi : bits 1..6, dimanche : bit 0
+    for (unsigned d = 0; d < 7; d++) {
+      char c = text[i + d];
+      if (c != '0' && c != '1')
+        return false;
+      if (c == '1')
+        slot.days |= 1 << ((d + 1) % 7);
+    }
+    const char *t = text + i + 7;
+    if (t[0] != ' ' || t[3] != ':' || !isdigit(t[1]) || !isdigit(t[2]) || !isdigit(t[4]) || !isdigit(t[5]))
+      return false;
+    slot.hour = (t[1] - '0') * 10 + t[2] - '0';
+    slot.minute = (t[4] - '0') * 10 + t[5] - '0';
+    if (slot.hour > 23 || slot.minute > 59)
+      return false;
+    parsed[n++] = slot;
+    i += 13;
+    if (i < length) {
+      if (text[i] != ';')
+        return false;
+      i++;
+    }
+  }
+  memcpy(slots, parsed, n * sizeof(CalendarSlot));
+  count = n;
+  return true;
+}
+
+/**
+ * @brief Writes the slots in the text format accepted by parse().
+ *
+ * @return Length of the text.
+ */
+int Calendar::format(char *buffer, unsigned size) {
+  unsigned n = 0;
+  buffer[0] = 0;
+  for (unsigned i = 0; i < count && n + 14 <= size; i++) {
+    if (i > 0)
+      buffer[n++] = ';';
+    for (unsigned d = 0; d < 7; d++)
+      buffer[n++] = slots[i].days & (1 << ((d + 1) % 7)) ? '1' : '0';
+    n += snprintf(buffer + n, size - n, " %02d:%02d", slots[i].hour, slots[i].minute);
+  }
+  return n;
+}
+
+/**
+ * @brief First slot occurrence strictly after the local time after.
+ *
+ * @return Local epoch of the occurrence, 0 if there is no active slot.
+ */
+uint32_t Calendar::next(uint32_t after) {
+  const CalendarSlot *active = slots;
+  unsigned n = count;
+  if (!enabled)
+    return 0;
+  if (n == 0) {
+    active = &daily;
+    n = 1;
+  }
+  uint32_t best = 0;
+  uint32_t day = after / 86400;
+  for (unsigned i = 0; i < n; i++) {
+    uint32_t time = active[i].hour * 3600UL + active[i].minute * 60UL;
+    // Une occurrence au plus tard dans 7 jours (aujourd'hui si l'heure n'est pas passée)
+    for (uint32_t d = day; d <= day + 7; d++) {
+      uint32_t t = d * 86400 + time;
+      if (t > after && (active[i].days & (1 << weekdayFromDays(d)))) {
+        if (best == 0 || t < best)
+          best = t;
+        break;
+      }
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Computes the next run from the last one, going back at most CALENDAR_CATCH_UP seconds.
+ *
+ * @param now Current UTC time.
+ */
+void Calendar::plan(uint32_t now) {
+  uint32_t from = now - CALENDAR_CATCH_UP;
+  if (lastRun > from && lastRun <= now)
+    from = lastRun;
+  nextRun = next(utcToLocal(from));
+}
+
+/**
+ * @brief Checks whether the planned run is due and plans the following one.
+ *
+ * A run late by more than CALENDAR_CATCH_UP seconds is dropped. Slots missed between the planned
+ * run and now are not run again.
+ *
+ * @param now Current UTC time.
+ * @return true if a cleaning cycle must start.
+ */
+boolean Calendar::fire(uint32_t now) {
+  if (nextRun == 0)
+    return false;
+  uint32_t due = localToUtc(nextRun);
+  if (now < due)
+    return false;
+  boolean run = now - due <= CALENDAR_CATCH_UP;
+  if (run) {
+    lastRun = now;
+    rtcSave();
+  }
+  nextRun = next(utcToLocal(now));
+  return run;
+}
+
+/**
+ * @brief Seconds to wait before the next check, at most CALENDAR_MAX_WAIT.
+ *
+ * @param now Current UTC time.
+ */
+unsigned Calendar::wait(uint32_t now) {
+  if (nextRun == 0)
+    return CALENDAR_MAX_WAIT;
+  uint32_t due = localToUtc(nextRun);
+  if (due <= now)
+    return 0;
+  return due - now > CALENDAR_MAX_WAIT ? CALENDAR_MAX_WAIT : due - now;
+}
+
+/**
+ * @brief Number of weekly slots (0: daily slot of the parameters).
+ */
+unsigned Calendar::getCount() {
+  return count;
+}
+
+uint32_t Calendar::getNextRun() {
+  return nextRun;
+}
+
+/**
+ * @brief Local time of the last run, 0 if none.
+ */
+uint32_t Calendar::getLastRun() {
+  return lastRun ? utcToLocal(lastRun) : 0;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file connection.cpp
+ * @brief Non-blocking WiFi/MQTT connection manager with jittered exponential backoff.
+ *
+ * The manager never waits for the network: each call to update() checks the WiFi and MQTT
+ * states and, when the broker is unreachable, makes at most one connection attempt when the
+ * backoff delay has elapsed. The delay doubles after each failure (up to CONN_BACKOFF_MAX)
+ * and is randomised by half of its value so that several clients do not retry in step.
+ * Reconnection count, total offline time and duration of the last outage are recorded.
+ */
+#include "connection.h"
+#include "heapMonitor.h"
+
+Connection::Connection() {
+  client = NULL;
+  user = NULL;
+  password = NULL;
+  onConnect = NULL;
+  clientId[0] = 0;
+  state = C_WIFI_WAIT;
+  everConnected = false;
+  backoff = CONN_BACKOFF_MIN;
+  nextAttempt = 0;
+  offlineSince = 0;
+  wifiLostSince = 0;
+  reconnectCount = 0;
+  offlineTime = 0;
+  lastReconnectTime = 0;
+}
+
+/**
+ * @brief Initialises the manager. The MQTT server and callback must already be set on client.
+ *
+ * @param client The MQTT client to manage.
+ * @param user MQTT user name.
+ * @param password MQTT password.
+ * @param onConnect Function called after each (re)connection, used to subscribe to topics.
+ */
+void Connection::begin(PubSubClient& client, const char* user, const char* password, void (*onConnect)(void)) {
+  this->client = &client;
+  this->user = user;
+  this->password = password;
+  this->onConnect = onConnect;
+  // Pour un même courtier les clients doivent avoir un id différent
+  sprintf(clientId, "ESP8266Client-%04lx", random(0xffff));
+  client.setSocketTimeout(CONN_SOCKET_TIMEOUT);
+  offlineSince = millis();
+  wifiLostSince = offlineSince;
+  nextAttempt = offlineSince;
+}
+
+/**
+ * @brief Records the beginning of an outage.
+ */
+void Connection::disconnected(unsigned long now) {
+  if (state == C_CONNECTED) {
+    offlineSince = now;
+    backoff = CONN_BACKOFF_MIN;
+    nextAttempt = now;
+  }
+}
+
+/**
+ * @brief Records the end of an outage and calls the connection hook.
+ */
+void Connection::connected(unsigned long now) {
+  unsigned long outage = now - offlineSince;
+  if (everConnected) {
+    reconnectCount++;
+    lastReconnectTime = outage;
+  }
+  offlineTime += outage;
+  everConnected = true;
+  backoff = CONN_BACKOFF_MIN;
+  state = C_CONNECTED;
+  if (onConnect)
+    onConnect();
+}
+
+/**
+ * @brief Advances the connection state machine. Must be called on every pass of loop().
+ */
+void Connection::update() {
+  unsigned long now = millis();
+  if (WiFi.status() != WL_CONNECTED) {
+    disconnected(now);
+    if (state != C_WIFI_WAIT) {
+      wifiLostSince = now;
+      state = C_WIFI_WAIT;
+    }
+    // Le WiFi se reconnecte seul (setAutoReconnect), redémarrer en dernier recours
+    if (now - wifiLostSince > WIFI_RESTART_TIMEOUT) {
+      heapMonitor.snapshot();
+      ESP.restart();
+    }
+    return;
+  }
+  if (client->connected()) {
+    if (state != C_CONNECTED)
+      connected(now);
+    return;
+  }
+  disconnected(now);
+  state = C_BACKOFF;
+  if ((long)(now - nextAttempt) < 0)
+    return;
+  if (client->connect(clientId, user, password)) {
+    connected(millis());
+    return;
+  }
+  Serial.printf("MQTT connection failed, state %d, retry in %lu ms\n", client->state(), backoff);
+  // Gigue : attente comprise entre backoff/2 et backoff
+  nextAttempt = millis() + backoff / 2 + random(backoff / 2 + 1);
+  backoff *= 2;
+  if (backoff > CONN_BACKOFF_MAX)
+    backoff = CONN_BACKOFF_MAX;
+}
+
+boolean Connection::isConnected() {
+  return state == C_CONNECTED;
+}
+
+unsigned Connection::getState() {
+  return state;
+}
+
+/**
+ * @brief Number of reconnections after a loss of the broker connection.
+ */
+unsigned Connection::getReconnectCount() {
+  return reconnectCount;
+}
+
+/**
+ * @brief Total time spent without broker connection in ms, current outage included.
+ */
+unsigned long Connection::getOfflineTime() {
+  if (state == C_CONNECTED)
+    return offlineTime;
+  return offlineTime + (millis() - offlineSince);
+}
+
+/**
+ * @brief Duration of the last outage (time to reconnect) in ms.
+ */
+unsigned long Connection::getLastReconnectTime() {
+  return lastReconnectTime;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file event.cpp
+ * @brief Text rendering of the binary log records, and parsing of the legacy text lines.
+ */
+#include "event.h"
+#include "wallClock.h"
+
+/**
+ * @brief Returns a human-readable string for a reset reason (rst_info.reason).
+ */
+const char* resetText(unsigned reason) {
+  switch (reason) {
+  case REASON_DEFAULT_RST:
+    return "Startup power on";
+  case REASON_WDT_RST:
+    return "Watch dog reset ";
+  case REASON_EXCEPTION_RST:
+    return "Exception reset";
+  case REASON_SOFT_WDT_RST:
+    return "Software watch dog reset";
+  case REASON_SOFT_RESTART:
+    return "Software restart";
+  case REASON_DEEP_SLEEP_AWAKE:
+    return "Wake from deep-sleep";
+  case REASON_EXT_SYS_RST:
+    return "Watch dog reset (ext)";
+  default:
+    return "Unknown reset cause";
+  };
+}
+
+/**
+ * @brief Returns the message associated with a record.
+ */
+const char* eventText(const LogRecord* record) {
+  switch (record->code) {
+  case EV_BOOT:
+    return resetText(record->arg);
+  case EV_START_SCHEDULED:
+    return "Start scheduled clean cycle";
+  case EV_START_MANUAL:
+    return "Start manual cycle";
+  case EV_END_TIME:
+    return "End time cycle";
+  case EV_END_COUNT:
+    return "End count cycle";
+  case EV_PARAM_MIGRATED:
+    return "Legacy parameters corrected";
+  default:
+    return "Unknown event";
+  }
+}
+
+/**
+ * @brief Renders a record as a log line "dd/mm/yyyy hh:mm:ss - message\n".
+ *
+ * @return Length of the line written in buffer.
+ */
+int renderEvent(const LogRecord* record, char* buffer, unsigned size) {
+  DateTime dateTime;
+  epochToDateTime(record->epoch, &dateTime);
+  int n = formatDateTime(&dateTime, buffer, size);
+  if (n < (int)size)
+    n += snprintf(buffer + n, size - n, " - %s\n", eventText(record));
+  if (n >= (int)size)
+    n = size - 1;
+  return n;
+}
+
+/**
+ * @brief Parses a legacy text log line "dd/mm/yyyy hh:mm:ss - message" into a record.
+ *
+ * The message must be the text of a known event, as rendered by eventText(): the record then
+ * renders the same line.
+ *
+ * @return false if the line is malformed or its message unknown.
+ */
+boolean parseEvent(const char* line, unsigned length, LogRecord* record) {
+  static const uint8_t position[6] = { 0, 3, 6, 11, 14, 17 };
+  static const uint8_t width[6] = { 2, 2, 4, 2, 2, 2 };
+  unsigned value[6];
+  while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+    length--;
+  if (length <= 22 || memcmp(line + 19, " - ", 3) != 0)
+    return false;
+  for (int i = 0; i < 6; i++) {
+    value[i] = 0;
+    for (int k = 0; k < width[i]; k++) {
+      char c = line[position[i] + k];
+      if (c < '0' || c > '9')
+        return false;
+      value[i] = value[i] * 10 + c - '0';
+    }
+  }
+  if (value[0] < 1 || value[0] > 31 || value[1] < 1 || value[1] > 12 || value[2] < 1970
+    || value[3] > 23 || value[4] > 59 || value[5] > 59)
+    return false;
+  record->epoch = daysFromCivil(value[2], value[1], value[0]) * 86400UL
+    + value[3] * 3600UL + value[4] * 60UL + value[5];
+  record->reserved = 0;
+  const char* message = line + 22;
+  unsigned messageLength = length - 22;
+  for (uint8_t code = EV_BOOT; code <= EV_PARAM_MIGRATED; code++) {
+    // Argument des événements de boot : cause du reset
+    unsigned last = code == EV_BOOT ? REASON_EXT_SYS_RST : 0;
+    for (unsigned arg = 0; arg <= last; arg++) {
+      record->code = code;
+      record->arg = arg;
+      const char* text = eventText(record);
+      if (strlen(text) == messageLength && memcmp(text, message, messageLength) == 0)
+        return true;
+    }
+  }
+  return false;
+}
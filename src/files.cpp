@@ -6,48 +6,78 @@
 #ifndef __FILE_H
 #include "files.h"
 
+boolean FileLittleFS::mounted = false;
+
 FileLittleFS::FileLittleFS(const char *fileName) {
   // path = malloc(strlen(fileName)+1);
   strcpy(path, fileName);
   connectFs();
 }
 
-void FileLittleFS::connectFs() {
+// Montage unique du système de fichiers
+boolean FileLittleFS::connectFs() {
+  if (mounted)
+    return true;
   if (!LittleFS.begin()) {
     Serial.println("Echec du montage LittleFS");
-    return;
+    return false;
   }
+  mounted = true;
+  return true;
 }
-// lecture d'un fichier
-String FileLittleFS::readFile() {
+// Lecture d'un fichier dans buffer, terminé par un zéro
+// Au plus size-1 caractères sont lus
+// Retourne le nombre de caractères lus, -1 en cas d'échec
+int FileLittleFS::readInto(char *buffer, size_t size) {
   // Serial.printf("Lecture du fichier: %s  ", path);
   file = LittleFS.open(FileLittleFS::path, "r");
   if (!file || file.isDirectory()) {
     Serial.println("Echec de la lecture");
-    return String("");
+    buffer[0] = 0;
+    return -1;
   }
-  return file.readString();
+  int n = file.read((uint8_t *)buffer, size - 1);
+  buffer[n] = 0;
+  file.close();
+  return n;
 }
 
-void FileLittleFS::writeFile(const char *message, const char *mode) {
-  file = LittleFS.open(path, mode);
-  if (!file) {
-    Serial.println("Echec de l'ouverture du fichier!");
-    return;
+// Ouverture en lecture pour une lecture ligne par ligne (readLine)
+// Le curseur est conservé dans file jusqu'à close()
+boolean FileLittleFS::openRead() {
+  file = LittleFS.open(path, "r");
+  if (!file || file.isDirectory()) {
+    Serial.println("Echec de la lecture");
+    return false;
   }
-  if (!file.print(message)) {
-    Serial.println("Erreur ecriture");
+  return true;
+}
+
+// Lecture de la ligne suivante ('\n' compris) dans buffer
+// Une ligne plus longue que size-1 est rendue en plusieurs morceaux
+// Retourne le nombre de caractères lus, 0 en fin de fichier
+int FileLittleFS::readLine(char *buffer, unsigned size) {
+  unsigned n = 0;
+  while (n < size - 1 && file.available()) {
+    int c = file.read();
+    if (c < 0)
+      break;
+    buffer[n++] = (char)c;
+    if (c == '\n')
+      break;
   }
-  file.close();
+  buffer[n] = 0;
+  return n;
 }
 
-void FileLittleFS::writeFile(String message, const char *mode) {
+void FileLittleFS::writeFile(const char *message, const char *mode) {
   file = LittleFS.open(path, mode);
   if (!file) {
     Serial.println("Echec de l'ouverture du fichier!");
     return;
   }
-  if (!file.print(message)) {
+  int written = file.print(message);
+  if (!written) {
     Serial.println("Erreur ecriture");
   }
   file.close();
@@ -66,39 +96,18 @@ void FileLittleFS::listDir() {
   Serial.println();
 }
 
+// Taille du fichier, -1 s'il n'existe pas
 int FileLittleFS::fileSize() {
-  Dir dir = LittleFS.openDir("");
-  while (dir.next()) {
-    // Serial.print (dir.fileName ());
-    if (strcmp(dir.fileName().c_str(), path) == 0) {
-      return static_cast<int>(dir.fileSize());
-    }
-  }
-  return -1;
-}
-
-void FileLittleFS::purge(unsigned size) {
-  Dir dir = LittleFS.openDir("");
-  while (dir.next()) {
-    // Serial.print (dir.fileName ());
-    if (strcmp(dir.fileName().c_str(), path) == 0) {
-      unsigned file_size = static_cast<unsigned>(dir.fileSize());
-      if (file_size > size) {
-        deleteFile();
-        // Serial.printf("%s %s\n", "purge", dir.fileName().c_str());
-      }
-    }
-  }
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return -1;
+  int size = static_cast<int>(f.size());
+  f.close();
+  return size;
 }
 
 boolean FileLittleFS::exist() {
-  Dir dir = LittleFS.openDir("");
-  while (dir.next()) {
-    // Serial.print (dir.fileName ());
-    if (strcmp(dir.fileName().c_str(), path) == 0)
-      return true;
-  }
-  return false;
+  return LittleFS.exists(path);
 }
 
 void FileLittleFS::deleteFile() {
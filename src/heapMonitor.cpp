@@ -0,0 +1,110 @@
+/**
+ * @file heapMonitor.cpp
+ * @brief Heap telemetry: free memory, fragmentation and largest free block with watermarks.
+ *
+ * The worst values are kept since boot and since the start of the current cleaning cycle. Each
+ * sample is mirrored in RTC user memory with a checksum, so the heap state just before any
+ * reset, deliberate or not, is available after the reboot.
+ */
+#include <stddef.h>
+#include "heapMonitor.h"
+
+HeapMonitor heapMonitor;
+
+HeapMonitor::HeapMonitor() {
+  memset(&last, 0, sizeof(last));
+  memset(&worst, 0, sizeof(worst));
+  memset(&cycle, 0, sizeof(cycle));
+  memset(&previous, 0, sizeof(previous));
+  previousValid = false;
+}
+
+/**
+ * @brief Reads the record left by the previous run, then takes the first sample.
+ */
+void HeapMonitor::begin() {
+  if (ESP.rtcUserMemoryRead(HEAP_RTC_OFFSET, (uint32_t *)&previous, sizeof(previous)))
+    previousValid = previous.magic == HEAP_RTC_MAGIC && previous.checksum == checksum(&previous);
+  worst.freeHeap = UINT32_MAX;
+  worst.maxBlock = UINT32_MAX;
+  worst.fragmentation = 0;
+  cycle = worst;
+  sample();
+}
+
+void HeapMonitor::lower(HeapStat *worst, const HeapStat *stat) {
+  if (stat->freeHeap < worst->freeHeap)
+    worst->freeHeap = stat->freeHeap;
+  if (stat->maxBlock < worst->maxBlock)
+    worst->maxBlock = stat->maxBlock;
+  if (stat->fragmentation > worst->fragmentation)
+    worst->fragmentation = stat->fragmentation;
+}
+
+uint32_t HeapMonitor::checksum(const HeapRecord *record) {
+  uint32_t sum = 0;
+  const uint32_t *words = (const uint32_t *)record;
+  for (unsigned i = 0; i < offsetof(HeapRecord, checksum) / 4; i++)
+    sum = (sum << 1 | sum >> 31) + words[i];
+  return sum;
+}
+
+void HeapMonitor::rtcSave(boolean deliberate) {
+  HeapRecord record;
+  record.magic = HEAP_RTC_MAGIC;
+  record.uptime = millis() / 1000;
+  record.last = last;
+  record.worst = worst;
+  record.deliberate = deliberate;
+  record.checksum = checksum(&record);
+  ESP.rtcUserMemoryWrite(HEAP_RTC_OFFSET, (uint32_t *)&record, sizeof(record));
+}
+
+/**
+ * @brief Samples the heap and updates the watermarks and the RTC record.
+ */
+void HeapMonitor::sample() {
+  last.freeHeap = ESP.getFreeHeap();
+  last.maxBlock = ESP.getMaxFreeBlockSize();
+  last.fragmentation = ESP.getHeapFragmentation();
+  lower(&worst, &last);
+  lower(&cycle, &last);
+  rtcSave(false);
+}
+
+/**
+ * @brief Restarts the watermarks of the cleaning cycle.
+ */
+void HeapMonitor::startCycle() {
+  cycle = last;
+}
+
+/**
+ * @brief Last sample before a deliberate restart.
+ */
+void HeapMonitor::snapshot() {
+  sample();
+  rtcSave(true);
+}
+
+const HeapStat *HeapMonitor::getLast() {
+  return &last;
+}
+
+const HeapStat *HeapMonitor::getWorst() {
+  return &worst;
+}
+
+/**
+ * @brief Worst values of the current cycle, or of the last one when no cycle is running.
+ */
+const HeapStat *HeapMonitor::getCycle() {
+  return &cycle;
+}
+
+/**
+ * @brief Record of the previous run, NULL if RTC memory held none (power on).
+ */
+const HeapRecord *HeapMonitor::getPrevious() {
+  return previousValid ? &previous : NULL;
+}
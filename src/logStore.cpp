@@ -0,0 +1,385 @@
+/**
+ * @file logStore.cpp
+ * @brief Circular log store made of fixed-size segments on LittleFS.
+ *
+ * The segments hold fixed-size binary records (LogRecord) that are rendered as text lines
+ * only when the log is read back. A legacy text log file is converted into records at boot, then
+ * deleted.
+ * Appending only touches the current segment, which makes it O(1). When the current segment
+ * is full the store moves to the next one, truncating it: the oldest segment is dropped first
+ * and the total size never exceeds LOG_SEGMENTS * LOG_SEGMENT_SIZE. Reading goes through the
+ * segments from the oldest to the current one.
+ *
+ * Records are first collected in a RAM buffer mirrored in RTC user memory, and written to
+ * flash in batches by flush(). The current segment stays open for appending, so a batch is one
+ * write and one sync without any open (an open allocates a descriptor on the heap); files are
+ * only opened on rotation, clear() and read back. Records pending at a reset are recovered from
+ * RTC memory by begin().
+ */
+#include "logStore.h"
+#include "files.h"
+
+LogStore::LogStore() {
+  current = 0;
+  currentSize = 0;
+  readFirst = 0;
+  readStep = LOG_SEGMENTS;
+  buffered = 0;
+  flushCount = 0;
+  savedOpens = 0;
+  savedBytes = 0;
+}
+
+void LogStore::segmentName(char *name, unsigned segment) {
+  sprintf(name, LOG_SEGMENT_NAME, segment);
+}
+
+/**
+ * @brief Restores the current segment from the index file and opens it for appending.
+ *
+ * The legacy log file, if any, is converted into records and deleted.
+ *
+ * @param legacyName Name of the legacy single log file.
+ */
+void LogStore::begin(const char *legacyName) {
+  FileLittleFS::connectFs();
+  current = 0;
+  File index = LittleFS.open(LOG_INDEX_NAME, "r");
+  if (index) {
+    int c = index.read();
+    if (c >= '0' && c < '0' + LOG_SEGMENTS)
+      current = c - '0';
+    index.close();
+  }
+  char name[32];
+  segmentName(name, current);
+  // Segment courant conservé ouvert en ajout
+  segment = LittleFS.open(name, "a");
+  currentSize = 0;
+  if (segment) {
+    currentSize = segment.size();
+    // Supprimer un enregistrement incomplet (coupure pendant l'écriture)
+    if (currentSize % sizeof(LogRecord) != 0) {
+      currentSize -= currentSize % sizeof(LogRecord);
+      segment.truncate(currentSize);
+    }
+  }
+  migrate(legacyName);
+  // Écrire les enregistrements en attente lors du reset
+  rtcRestore();
+  flush();
+}
+
+/**
+ * @brief Mirrors record index of the buffer and the header in RTC user memory.
+ *
+ * The header holds a magic number, the record count and an additive checksum of the records.
+ */
+void LogStore::rtcSave(unsigned index) {
+  uint32_t header[3];
+  if (index < buffered)
+    ESP.rtcUserMemoryWrite(LOG_RTC_OFFSET + 3 + index * 2, (uint32_t *)&buffer[index], sizeof(LogRecord));
+  uint32_t sum = 0;
+  for (unsigned i = 0; i < buffered * 2; i++)
+    sum += ((uint32_t *)buffer)[i];
+  header[0] = LOG_RTC_MAGIC;
+  header[1] = buffered;
+  header[2] = sum;
+  ESP.rtcUserMemoryWrite(LOG_RTC_OFFSET, header, sizeof(header));
+}
+
+/**
+ * @brief Reloads the records left in RTC user memory by the previous run, if valid.
+ */
+void LogStore::rtcRestore() {
+  uint32_t header[3];
+  buffered = 0;
+  if (!ESP.rtcUserMemoryRead(LOG_RTC_OFFSET, header, sizeof(header)))
+    return;
+  if (header[0] != LOG_RTC_MAGIC || header[1] == 0 || header[1] > LOG_BUFFER_LEN)
+    return;
+  if (!ESP.rtcUserMemoryRead(LOG_RTC_OFFSET + 3, (uint32_t *)buffer, header[1] * sizeof(LogRecord)))
+    return;
+  uint32_t sum = 0;
+  for (unsigned i = 0; i < header[1] * 2; i++)
+    sum += ((uint32_t *)buffer)[i];
+  if (sum == header[2])
+    buffered = header[1];
+}
+
+/**
+ * @brief Moves to the next segment, dropping its previous content, and keeps it open.
+ */
+void LogStore::rotate() {
+  char name[32];
+  if (segment)
+    segment.close();
+  current = (current + 1) % LOG_SEGMENTS;
+  segmentName(name, current);
+  segment = LittleFS.open(name, "w");
+  currentSize = 0;
+  File index = LittleFS.open(LOG_INDEX_NAME, "w");
+  if (index) {
+    index.write((uint8_t)('0' + current));
+    index.close();
+  }
+}
+
+/**
+ * @brief Appends a record to the write-behind buffer.
+ *
+ * The buffer is written to flash when LOG_FLUSH_THRESHOLD records are pending. When it is full
+ * because a rotation is held back by a read, the read is ended; if it is still full (segment
+ * that cannot be opened), the oldest pending record is dropped.
+ *
+ * @param record The record to append.
+ */
+void LogStore::append(const LogRecord *record) {
+  if (buffered == LOG_BUFFER_LEN) {
+    flush();
+    if (buffered == LOG_BUFFER_LEN && file) {
+      close();
+      flush();
+    }
+    if (buffered == LOG_BUFFER_LEN) {
+      buffered--;
+      memmove(buffer, buffer + 1, buffered * sizeof(LogRecord));
+      for (unsigned k = 0; k < buffered; k++)
+        rtcSave(k);
+    }
+  }
+  buffer[buffered++] = *record;
+  rtcSave(buffered - 1);
+  if (buffered >= LOG_FLUSH_THRESHOLD)
+    flush();
+}
+
+/**
+ * @brief Writes records to the open segment, rotating first whenever the next record would
+ * overflow it. A rotation onto a segment that the current read has not finished is held back.
+ *
+ * @param opens Incremented for each file opened (rotation, new try after a failed open).
+ * @return Number of records written, less than count if a segment could not be opened or the
+ * rotation is held back.
+ */
+unsigned LogStore::write(const LogRecord *records, unsigned count, unsigned *opens) {
+  unsigned i = 0;
+  while (i < count) {
+    if (currentSize + sizeof(LogRecord) > LOG_SEGMENT_SIZE) {
+      // Segment le plus ancien pas encore relu
+      if (readPending((current + 1) % LOG_SEGMENTS))
+        break;
+      rotate();
+      (*opens)++;
+    }
+    if (!segment) {
+      // Nouvel essai après un échec d'ouverture
+      char name[32];
+      segmentName(name, current);
+      segment = LittleFS.open(name, "a");
+      (*opens)++;
+    }
+    if (!segment) {
+      Serial.println("Echec de l'ouverture du fichier!");
+      break;
+    }
+    // Autant d'enregistrements que le segment peut en contenir
+    unsigned n = (LOG_SEGMENT_SIZE - currentSize) / sizeof(LogRecord);
+    if (n > count - i)
+      n = count - i;
+    currentSize += segment.write((const uint8_t *)&records[i], n * sizeof(LogRecord));
+    i += n;
+  }
+  if (i > 0)
+    segment.flush();
+  return i;
+}
+
+/**
+ * @brief Converts the lines of the legacy text log file into records, then deletes it.
+ *
+ * Lines that do not render a known event are dropped. The file is kept for the next boot only
+ * if a segment could not be written.
+ */
+void LogStore::migrate(const char *legacyName) {
+  File legacy = LittleFS.open(legacyName, "r");
+  if (!legacy)
+    return;
+  LogRecord batch[LOG_FLUSH_THRESHOLD];
+  unsigned n = 0;
+  unsigned opens = 0;
+  boolean written = true;
+  char line[96];
+  unsigned length = 0;
+  while (written) {
+    int c = legacy.read();
+    if (c >= 0 && c != '\n') {
+      // Ligne trop longue : fin ignorée, la ligne ne sera pas reconnue
+      if (length < sizeof(line))
+        line[length++] = (char)c;
+      continue;
+    }
+    if (length > 0 && parseEvent(line, length, &batch[n]))
+      n++;
+    length = 0;
+    if (n == LOG_FLUSH_THRESHOLD || (c < 0 && n > 0)) {
+      written = write(batch, n, &opens) == n;
+      n = 0;
+    }
+    if (c < 0)
+      break;
+  }
+  legacy.close();
+  if (written)
+    LittleFS.remove(legacyName);
+}
+
+/**
+ * @brief Writes the pending records to the current segment(s).
+ *
+ * If a segment cannot be opened or the rotation is held back by a read, the records already
+ * written are removed from the buffer and the others stay pending for the next flush.
+ */
+void LogStore::flush() {
+  unsigned opens = 0;
+  if (buffered == 0)
+    return;
+  unsigned i = write(buffer, buffered, &opens);
+  if (i == 0)
+    return;
+  flushCount++;
+  // Écriture par enregistrement : une ouverture et une validation chacun.
+  // Par lot : une validation, plus une par segment fermé ou ouvert
+  if (i > opens)
+    savedOpens += i - opens;
+  if (i > opens + 1)
+    savedBytes += (unsigned long)(i - opens - 1) * LOG_COMMIT_BYTES;
+  // Conserver les enregistrements non écrits
+  buffered -= i;
+  memmove(buffer, buffer + i, buffered * sizeof(LogRecord));
+  if (buffered == 0)
+    rtcSave(0);
+  for (unsigned k = 0; k < buffered; k++)
+    rtcSave(k);
+}
+
+/**
+ * @brief Deletes every segment and the index, then reopens the first segment.
+ */
+void LogStore::clear() {
+  char name[32];
+  close();
+  if (segment)
+    segment.close();
+  buffered = 0;
+  rtcSave(0);
+  for (unsigned i = 0; i < LOG_SEGMENTS; i++) {
+    segmentName(name, i);
+    LittleFS.remove(name);
+  }
+  LittleFS.remove(LOG_INDEX_NAME);
+  current = 0;
+  currentSize = 0;
+  segmentName(name, current);
+  segment = LittleFS.open(name, "w");
+}
+
+/**
+ * @brief Opens the next non-empty file of the reading sequence.
+ *
+ * @return false when every file has been read.
+ */
+boolean LogStore::openNext() {
+  char name[32];
+  while (readStep < LOG_SEGMENTS) {
+    segmentName(name, (readFirst + readStep) % LOG_SEGMENTS);
+    readStep++;
+    file = LittleFS.open(name, "r");
+    if (file && file.size() > 0)
+      return true;
+    if (file)
+      file.close();
+  }
+  return false;
+}
+
+/**
+ * @brief Starts reading the whole log from its oldest line.
+ */
+boolean LogStore::openRead() {
+  close();
+  // Le plus ancien segment suit le segment courant
+  readFirst = (current + 1) % LOG_SEGMENTS;
+  readStep = 0;
+  return openNext();
+}
+
+/**
+ * @brief Reads the next line ('\n' included) into buffer.
+ *
+ * Records are rendered by renderEvent().
+ *
+ * @return Number of characters read, 0 when the whole log has been read.
+ */
+int LogStore::readLine(char *buffer, unsigned size) {
+  unsigned n = 0;
+  buffer[0] = 0;
+  while (n == 0) {
+    LogRecord record;
+    if (file.read((uint8_t *)&record, sizeof(record)) == sizeof(record))
+      n = renderEvent(&record, buffer, size);
+    if (n == 0) {
+      file.close();
+      if (!openNext())
+        break;
+    }
+  }
+  buffer[n] = 0;
+  return n;
+}
+
+/**
+ * @brief true if the current read still has to read segment (or is reading it).
+ */
+boolean LogStore::readPending(unsigned segment) {
+  if (!file)
+    return false;
+  unsigned position = (segment + LOG_SEGMENTS - readFirst) % LOG_SEGMENTS;
+  return position + 1 >= readStep;
+}
+
+void LogStore::close() {
+  if (file)
+    file.close();
+  readStep = LOG_SEGMENTS;
+}
+
+/**
+ * @brief Number of records waiting in the write-behind buffer.
+ */
+unsigned LogStore::getBuffered() {
+  return buffered;
+}
+
+/**
+ * @brief Number of batches written to flash.
+ */
+unsigned LogStore::getFlushCount() {
+  return flushCount;
+}
+
+/**
+ * @brief Number of segment open/append/close cycles saved by batching and the open segment
+ * (records written minus opens).
+ */
+unsigned LogStore::getSavedOpens() {
+  return savedOpens;
+}
+
+/**
+ * @brief Flash bytes saved by batching: commits avoided (records written minus commits) times
+ * LOG_COMMIT_BYTES.
+ */
+unsigned long LogStore::getSavedBytes() {
+  return savedBytes;
+}
@@ -18,25 +18,28 @@
  *      - bootRaison(): Returns a human-readable string that explains the reason for the last system reset.
  *
  *  - File Parameters Management:
- *      - initFileParam(): Initializes the parameters file (using FileLittleFS), writes default parameters if needed,
- *                         and loads parameters into the system.
+ *      - initFileParam(): Loads the parameters from the CRC-protected binary store (params.h), migrating the
+ *                         former text file field by field (out-of-range values clamped and logged) or
+ *                         writing default parameters if needed.
  *
  *  - WiFi and MQTT Configuration:
  *      - initWifiStation(): Sets WiFi mode, attempts to connect to the specified SSID, and configures auto-reconnect.
- *      - initMQTTClient(): Configures the MQTT client, connects to the broker, subscribes to specific topics, and
- *                          handles reconnection if needed.
+ *      - initMQTTClient(): Configures the MQTT client and hands it to the non-blocking connection manager,
+ *                          which subscribes to the topics on each (re)connection (subscribeTopics()).
  *
  *  - Logging:
- *      - logsWrite(): Writes a log message with a timestamp to the log file, used primarily for recording boot reasons.
- *      - writeLogs(): Conditionally writes log messages depending on the log status.
+ *      - logsWrite(): Writes a binary event record (epoch, event code, argument) to the circular log store
+ *                     (logStore), used primarily for recording boot reasons. Text is rendered on read.
+ *      - writeLogs(): Conditionally writes event records depending on the log status.
  *
  *  - Parameter Handling:
- *      - split(): Tokenizes a parameter string into an array of items based on a given delimiter.
- *      - setParam(): Parses the parameter string and updates configuration variables (including cycle parameters,
- *                    scheduled clean time, and logging status).
+ *      - setParam(): Updates configuration variables from the Params structure (including cycle parameters,
+ *                    scheduled clean time, and logging status). Parsing, validation and formatting of the
+ *                    parameter string are driven by the compile-time schema paramSchema (params.h).
  *
  *  - Time Management:
- *      - getDate(), getHour(), and getMinutes(): Retrieve and format the current date and time using an NTP client.
+ *      - getDate(): Formats the local time read from the wall clock (wallClock.h), which syncs with NTP
+ *                   on its own schedule and interpolates with millis().
  *
  *  - Robot Cleaning Cycle Tasks:
  *      - robotTask(): Alternates robot motion (forward/reverse) with randomized timing intervals,
@@ -45,22 +48,32 @@
  *      - endCycle(): A helper to conclude a cycle, reset timers and state, and publish a cycle reset.
  *
  *  - Scheduled Operations:
- *      - scheduleCleanTask(): Checks at regular intervals whether the scheduled clean time has been reached
- *                             and starts the cleaning cycle if conditions are met.
+ *      - scheduleCleanTask(): Monostable armed for the next run computed by the weekly calendar (calendar.h),
+ *                             which starts the cleaning cycle and catches up a recently missed slot.
  *
  *  - MQTT Callback:
- *      - PubSubCallback(): Processes incoming MQTT messages to update parameters, start/stop robot tasks,
- *                          retrieve logs, and reset the system.
+ *      - PubSubCallback(): Dispatches incoming MQTT messages, through a compile-time sorted table of topic
+ *                          suffixes, to handlers that update parameters, start/stop robot tasks,
+ *                          retrieve logs, and reset the system. Payloads are passed as (pointer, length) views.
  *
  *  - Main Application Flow:
  *      - setup(): Initializes Serial communication, pin modes, file systems, network connections, MQTT client,
  *                 NTP client, logging, parameter setup, and task scheduling.
- *      - loop(): Main execution loop that handles WiFi/MQTT reconnections, feeds the watchdog timer, processes OTA updates,
- *                and repeatedly triggers scheduled task execution.
+ *      - loop(): Main execution loop that advances WiFi/MQTT reconnections without blocking, feeds the watchdog timer, processes OTA updates,
+ *                and repeatedly triggers scheduled task execution. Between cycles it sleeps in modem-sleep or light-sleep
+ *                until the next task deadline, within the MQTT latency limit of power.h (powerUpdate()).
  *
  * Notes:
  *  - The code includes conditional compilation for debugging and timing adjustments (DEBUG_TIME).
  *  - Task scheduling and timed operations are managed by the timerTask module.
+ *  - The duration of each loop() section and the lateness of the tasks are kept in latency histograms
+ *    (profile.h), published on request (TOPIC_GET_PROFILE).
+ *  - Every MQTT message goes through the bounded outbound queue (outbox.h), drained a few messages
+ *    per loop() pass: events are retried in order, state topics keep only their latest value.
+ *    The replies made of several messages (logs, diagnostic, profile) are posted as room frees up
+ *    in the queue (pumpLogs(), pumpReplies()).
+ *  - The robot state (cycle progress, current leg, schedule) is published as one retained frame on
+ *    TOPIC_STATE when it changes, at most every STATUS_MIN_INTERVAL ms (status.h).
  *  - All topics for MQTT communications (parameters, status, logs, etc.) are defined within the project context.
  *
  * Usage:
@@ -80,81 +93,62 @@ inline void initOTA() {
 const char* bootRaison() {
   rst_info* resetInfo;
   resetInfo = ESP.getResetInfoPtr();
-  switch (resetInfo->reason) {
-  case REASON_DEFAULT_RST:
-    return "Startup power on";
-  case REASON_WDT_RST:
-    return "Watch dog reset ";
-  case REASON_EXCEPTION_RST:
-    return "Exception reset";
-  case REASON_SOFT_WDT_RST:
-    return "Software watch dog reset";
-  case REASON_SOFT_RESTART:
-    return "Software restart";
-  case REASON_DEEP_SLEEP_AWAKE:
-    return "Wake from deep-sleep";
-  case REASON_EXT_SYS_RST:
-    return "Watch dog reset (ext)";
-  default:
-    return "Unknown reset cause";
-  };
-}
-
-FileLittleFS* initFileParam(boolean force) {
-  fileParam = new FileLittleFS(PARAM_FILE_NAME);
-  if (!fileParam->exist() || force) {
-    fileParam->writeFile(PARAM, "w");
-    strcpy(tabParam, PARAM);
-  }
-  else {
-    strcpy(tabParam, fileParam->readFile().c_str());
-    fileParam->close();
+  return resetText(resetInfo->reason);
+}
+
+// Charge les paramètres depuis le stockage binaire (params.h)
+// Au premier boot après mise à jour, l'ancien fichier texte
+// PARAM_FILE_NAME est migré champ par champ puis supprimé
+// Le chargement précède toujours l'écriture : avec force, les valeurs
+// par défaut sont écrites dans l'emplacement le plus ancien avec la
+// séquence suivante, et ne peuvent être masquées au boot suivant
+// Retourne le masque des champs de l'ancien fichier corrigés (1 << ParamId)
+uint16_t initFileParam(boolean force) {
+  uint16_t corrected = 0;
+  boolean loaded = paramLoad(&params);
+  if (force || !loaded) {
+    FileLittleFS fileText(PARAM_FILE_NAME);
+    paramDefaults(&params);
+    if (!force && fileText.exist()) {
+      char text[PARAM_TEXT_MAX];
+      int length = fileText.readInto(text, sizeof(text));
+      corrected = length < 0 ? (1 << PARAM_LEN) - 1 : paramMigrate(text, length, &params);
+      for (int id = 0; id < PARAM_LEN; id++) {
+        if (corrected & (1 << id))
+          Serial.printf("Parametre %s corrige : %d\n", paramSchema[id].name, paramGet(&params, id));
+      }
+    }
+    if (paramSave(&params) && fileText.exist())
+      fileText.deleteFile();
   }
-  return fileParam;
+  // Chaine publiée sur TOPIC_PARAM
+  paramFormat(&params, tabParam, sizeof(tabParam));
+  return corrected;
 }
 
 void initWifiStation() {
   WiFi.mode(WIFI_STA);
   WiFi.begin(ssid, password);
-  while (WiFi.waitForConnectResult() != WL_CONNECTED) {
-    Serial.printf("Wifi %s not connected! Rebooting...", ssid);
-    delay(5000);
-    ESP.restart();
-  }
   WiFi.setHostname(HOSTNAME);
   WiFi.setAutoReconnect(true);
   WiFi.persistent(true);
+  // Attente bornée au boot afin de dater le log de démarrage,
+  // la connexion est ensuite suivie par connection
+  if (WiFi.waitForConnectResult(WIFI_BOOT_TIMEOUT) != WL_CONNECTED) {
+    Serial.printf("Wifi %s not connected!\n", ssid);
+  }
   initOTA();
 }
 
-void initMQTTClient() {
-  // Connecting to MQTT server
-  mqttClient.setServer(mqttServer, mqttPort);
-  mqttClient.setCallback(PubSubCallback);
-  while (!mqttClient.connected()) {
-    Serial.println(String("Connecting to MQTT (") + mqttServer + ")...");
-    // Pour un même courtier les clients doivent avoir un id différent
-    String clientId = "ESP8266Client-";
-    clientId += String(random(0xffff), HEX);
-
-    if (mqttClient.connect(clientId.c_str(), mqttUser, mqttPassword)) {
-      Serial.println("MQTT client connected");
-      // digitalWrite(GPIO2_LED, LOW);
-    }
-    else {
-      Serial.print("\nFailed with state ");
-      Serial.println(mqttClient.state());
-      // digitalWrite(GPIO2_LED, HIGH);
-      if (WiFi.status() != WL_CONNECTED) {
-        initWifiStation();
-      }
-      delay(500);
-    }
-  }
+// Appelé par connection à chaque (re)connexion au courtier
+void subscribeTopics() {
+  static boolean firstConnection = true;
+  Serial.println("MQTT client connected");
   Serial.print("IP address: ");
   Serial.println(WiFi.localIP());
   // Abonne le client aux messages 
   mqttClient.subscribe(TOPIC_SET_PARAM);
+  mqttClient.subscribe(TOPIC_PATCH_PARAM);
   mqttClient.subscribe(TOPIC_GET_PARAM);
   mqttClient.subscribe(TOPIC_GET_VERSION);
   mqttClient.subscribe(TOPIC_GET_LOGS);
@@ -163,408 +157,774 @@ void initMQTTClient() {
   mqttClient.subscribe(TOPIC_MANUAL);
   mqttClient.subscribe(TOPIC_DELETE_LOGS);
   mqttClient.subscribe(TOPIC_RESET);
+  mqttClient.subscribe(TOPIC_GET_DIAG);
+  mqttClient.subscribe(TOPIC_SET_CALENDAR);
+  mqttClient.subscribe(TOPIC_GET_CALENDAR);
+  mqttClient.subscribe(TOPIC_GET_PROFILE);
+  if (firstConnection) {
+    outbox.post(TOPIC_RESET_CYCLE, "");
+    firstConnection = false;
+  }
+}
+
+void initMQTTClient() {
+  // La connexion au serveur MQTT est établie sans blocage par connection.update()
+  mqttClient.setServer(mqttServer, mqttPort);
+  mqttClient.setCallback(PubSubCallback);
+  connection.begin(mqttClient, mqttUser, mqttPassword, subscribeTopics);
+  // Tous les messages sont publiés par la file d'émission (outbox.h)
+  outbox.begin(mqttClient);
+  statusPublisher.begin(outbox, TOPIC_STATE);
 }
 
 // Ecrire systématique d'un log
-// Utilisé par bootRaison
-void logsWrite(const char* msg) {
-  char buffer[80];
-  sprintf(buffer, "%s - %s\n", getDate(), msg);
-  fileLog->writeFile(buffer, "a");
+// Utilisé pour la cause du boot
+// Le journal contient des enregistrements binaires (voir event.h),
+// le texte n'est produit qu'à la relecture
+void logsWrite(uint8_t code, uint16_t arg) {
+  LogRecord record;
+  record.epoch = wallClock.local();
+  record.code = code;
+  record.reserved = 0;
+  record.arg = arg;
+  logStore.append(&record);
 }
 
 // Ecrire conditionnelle d'un log 'fonction du champ LOG_STATUS
-void writeLogs(const char* log) {
+void writeLogs(uint8_t code) {
   if (!logStatus)
     return;
-  char buffer[80];
-  sprintf(buffer, "%s - %s\n", getDate(), log);
-  fileLog->writeFile(buffer, "a");
-}
-
-/*
- * Retourne un tableau de PARAM_LEN chaines splittées par motif
- * Attention str est modifié par la fonction
- */
-Item* split(char* str, const char* motif) {
-  static Item items[PARAM_LEN + 1];
-  char* pch;
-  pch = strtok(str, motif);
-  int i = 0;
-  while (pch != NULL) {
-    strcpy(items[i++].item, pch);
-    pch = strtok(NULL, motif);
-  }
-  return items;
+  logsWrite(code, 0);
 }
 
+// Date courante formatée dans le buffer global date
 char* getDate() {
-  static char date[80];
-  ntpTime->update();
-  time_t epochTime = ntpTime->getEpochTime();
-  const struct tm* ptm = gmtime((time_t*)&epochTime);
-  sprintf(date, "%02d/%02d/%4d %s",
-    ptm->tm_mday,
-    (ptm->tm_mon + 1),
-    (ptm->tm_year + 1900),
-    ntpTime->getFormattedTime().c_str());
+  wallClock.format(date, sizeof(date));
   return date;
 }
 
-inline int getHour() {
-  return ntpTime->getHours();
+// Met à jour les variables du cycle à partir
+// de la structure des paramètres
+// Les champs marqués scaled dans paramSchema sont divisés par
+// DEBUG_TIME (vide ou égal à /10 si DEBUG est défini)
+inline int paramValue(const Params* p, int id) {
+  return paramSchema[id].scaled ? paramGet(p, id) DEBUG_TIME : paramGet(p, id);
 }
 
-inline int getMinutes() {
-  return ntpTime->getMinutes();
+void setParam(const Params* p) {
+  scheduleEnabled = paramValue(p, P_SCHEDULE_ENABLE);
+  scheduleH     = paramValue(p, P_SCHEDULE_H);
+  scheduleM     = paramValue(p, P_SCHEDULE_M);
+  minRandom_av  = paramValue(p, P_MIN_RANDOM_AV);
+  maxRandom_av  = paramValue(p, P_MAX_RANDOM_AV);
+  minRandom_ar  = paramValue(p, P_MIN_RANDOM_AR);
+  maxRandom_ar  = paramValue(p, P_MAX_RANDOM_AR);
+  reverse_cycle = paramValue(p, P_REVERSE);
+  nbCycles      = paramValue(p, P_N_CYCLES);
+  activeTime    = paramValue(p, P_ACTIVE_TIME);
+  logStatus     = paramValue(p, P_LOG_STATUS);
+  calendar.setDaily(scheduleEnabled, scheduleH, scheduleM);
 }
 
-// Met à jour les variables du cycle à partir
-// De la chaine param lue dans le fichier PARAM_FILE_NAME
-// et mis à jour par le message TOPIC_GET_PARAM
-// DEBUG_TIME est soit vide soit égal à  /10 (DEBUG défini)
-void setParam(const char* tabParam) {
-  char temp[50];
-  strcpy(temp, tabParam);
-  Item* paramItem = split(temp, ":");
-  scheduleEnabled = atoi(get(paramItem, SCHEDULED_ENABLE));
-  scheduleH = atoi(get(paramItem, SCHEDULED_TIME_H));
-  scheduleM = atoi(get(paramItem, SCHEDULED_TIME_M));
-  minRandom_av = atoi(get(paramItem, MIN_RANDOM_AV))  DEBUG_TIME;
-  maxRandom_av = atoi(get(paramItem, MAX_RAMDOM_AV))  DEBUG_TIME;
-  minRandom_ar = atoi(get(paramItem, MIN_RANDOM_AR))  DEBUG_TIME;
-  maxRandom_ar = atoi(get(paramItem, MAX_RAMDOM_AR))  DEBUG_TIME;
-  reverse_cycle= atoi(get(paramItem, REVERSE))    DEBUG_TIME;
-  nbCycles  = atoi(get(paramItem, N_CYCLES))    DEBUG_TIME;
-  activeTime= atoi(get(paramItem, ACTIVE_TIME)) DEBUG_TIME;
-  logStatus = atoi(get(paramItem, LOG_STATUS));
-}
-
-/**
- * Modifie un paramètre
- * tabParam : chaine de paramètres origine
- * theParam: valareur du paramètre à modifier (sans les séparateurs)
- * pos : position du paramètre
- * @returns chaine de paramètres mis à jour
- */
-char* modifyParam(const char* tabParam, const char* theParam, int pos) {
-  static char temp[50];
-  strcpy(temp, tabParam);
-  Item* paramItem = split(temp, ":");
-  strcpy(get(paramItem, pos), theParam);
-  strcpy(temp, "");
-  int i = 0;
-  for (; i < PARAM_LEN - 1; i++) {
-    strcat(temp, get(paramItem, i));
-    strcat(temp, ":");
+// Publier les champs modifiés (masque 1 << ParamId) sur TOPIC_PARAM_DELTA
+void publishParamDelta(uint16_t mask) {
+  char buffer[140];
+  paramFormatDelta(&params, mask, buffer, sizeof(buffer));
+  outbox.post(TOPIC_PARAM_DELTA, buffer);
+}
+
+// Appliquer un nouveau jeu de paramètres (TOPIC_SET_PARAM, TOPIC_PATCH_PARAM)
+// Seuls les champs modifiés sont réécrits dans tabParam, pris en compte
+// et publiés. Rien n'est écrit en flash si rien n'a changé.
+void applyParams(const Params* newParams) {
+  uint16_t mask = paramDiff(&params, newParams);
+  if (mask == 0)
+    return;
+  params = *newParams;
+  paramSave(&params);
+  for (int id = 0; id < PARAM_LEN; id++) {
+    if (mask & (1 << id))
+      paramPatch(tabParam, sizeof(tabParam), &params, id);
   }
-  strcat(temp, get(paramItem, i));
-  return temp;
+  setParam(&params);
+  // Réactualiser le temps de fonctionnement du robot seulement s'il a changé
+  if (mask & (1 << P_ACTIVE_TIME))
+    timerTask.setStartTime(idEndRobotTask, activeTime * 60000UL);
+  // Recalculer le prochain nettoyage programmé
+  if (mask & ((1 << P_SCHEDULE_ENABLE) | (1 << P_SCHEDULE_H) | (1 << P_SCHEDULE_M)))
+    planCalendar();
+  publishParamDelta(mask);
 }
- 
 
-void endCycle() {
+void endCycle(CleanCycle* cycle) {
   timerTask.t_stop(idRobotTask);
   timerTask.t_stop(idEndRobotTask);
-  currentCycle = 0;
+  cycle->count = 0;
   powerOff();
-  mqttClient.publish(TOPIC_RESET_CYCLE, "");
-  activeScheduledTask = false;
+  outbox.post(TOPIC_RESET_CYCLE, "");
+  cycle->scheduled = false;
 }
 
 // Timer
-// Appelé par le scheduler toute les currentRandomValue secondes
+// Appelé par le scheduler toute les cycle->randomValue ms
+// Le contexte est l'état du cycle (cleanCycle)
 // Avance-recule
-void robotTask() {
-  powerOff();
-  delay(500);
+void robotTask(void* context) {
+  CleanCycle* cycle = (CleanCycle*)context;
+  // Le temps mort avant changement de sens est assuré par relay
   // Nouveau temps d'avance ou de recul
-  // currentRandomValue = random(minRandom, maxRandom);
-  if (!direction) {
-    currentRandomValue = random(minRandom_av, maxRandom_av);
-    timerTask.setInterval(idRobotTask, currentRandomValue);
+  if (!cycle->direction) {
+    cycle->randomValue = random(minRandom_av * 1000L, maxRandom_av * 1000L);
+    timerTask.setInterval(idRobotTask, cycle->randomValue);
     if (!reverse_cycle)
       robotForward();
     else
       robotReturn();
   }
   else {
-    currentRandomValue = random(minRandom_ar, maxRandom_ar);
-    timerTask.setInterval(idRobotTask, currentRandomValue);
+    cycle->randomValue = random(minRandom_ar * 1000L, maxRandom_ar * 1000L);
+    timerTask.setInterval(idRobotTask, cycle->randomValue);
     if (!reverse_cycle)
       robotReturn();
     else
       robotForward();
   }
-  mqttClient.publish(TOPIC_CYCLE_TIME, randomBuffer);
-  direction = !direction;
-  if (currentCycle == nbCycles/2) {
+  outbox.post(TOPIC_CYCLE_TIME, randomBuffer);
+  cycle->legStart = wallClock.utc();
+  cycle->direction = !cycle->direction;
+  if (cycle->count == nbCycles/2) {
     reverse_cycle = !reverse_cycle;
-    strcpy(tabParam, modifyParam(tabParam, (reverse_cycle) ? "1" : "0", REVERSE));
-    mqttClient.publish(TOPIC_PARAM, tabParam);
+    params.reverse = reverse_cycle;
+    // Seul le champ modifié est réécrit dans la chaine
+    paramPatch(tabParam, sizeof(tabParam), &params, P_REVERSE);
+    publishParamDelta(1 << P_REVERSE);
+#if PARAM_LEGACY_PUSH
+    // Anciennes versions de l'application
+    outbox.post(TOPIC_PARAM, tabParam, OB_STATE);
+#endif
   }
-  if (++currentCycle >= nbCycles) {
-    endCycle();
-    writeLogs("End count cycle");
+  if (++cycle->count >= nbCycles) {
+    endCycle(cycle);
+    writeLogs(EV_END_COUNT);
   }
 }
 
 // Monostable appelé à la fin du temps de nettoyage
-void robotEndTask() {
-  endCycle();
-  writeLogs("End time cycle");
-}
-
-// Cycle programmé, appelé toute les minutes
-void scheduleCleanTask() {
-  if (scheduleEnabled) {
-    if (scheduleM == getMinutes() && scheduleH == getHour()) {
-      timerTask.t_start(idRobotTask);
-      timerTask.t_start(idEndRobotTask);
-      // Serial.println("scheduleCleanTask()");
-      writeLogs("Start scheduled clean cycle");
-      sprintf(bufferTime, "%02d:%02d\r", getHour(), getMinutes());
-      mqttClient.publish(TOPIC_SCHEDULED, bufferTime);
-      activeScheduledTask = true;
+void robotEndTask(void* context) {
+  endCycle((CleanCycle*)context);
+  writeLogs(EV_END_TIME);
+}
+
+// Armer le monostable du calendrier pour la prochaine échéance
+// Tant que l'heure n'est pas connue, nouvel essai après CALENDAR_RETRY
+void armCalendar() {
+  unsigned long interval = CALENDAR_RETRY;
+  if (wallClock.isSynced())
+    interval = calendar.wait(wallClock.utc()) * 1000UL;
+  timerTask.t_stop(idScheduleCleanTask);
+  timerTask.setInterval(idScheduleCleanTask, interval);
+  timerTask.t_start(idScheduleCleanTask);
+}
+
+// Calculer la prochaine échéance après une modification du calendrier
+void planCalendar() {
+  if (wallClock.isSynced())
+    calendar.plan(wallClock.utc());
+  armCalendar();
+}
+
+// Démarrage d'un cycle (calendrier ou commande)
+// t_start() exécute robotTask() immédiatement : le mode actif et le Ticker
+// rapide sont rétablis avant, la première commande du relais n'est pas
+// émise WiFi en veille
+void startCycle(uint8_t event) {
+  if (power.getState() != P_ACTIVE)
+    schedulerTicker.attach_ms(TIMER_TIC, Task::tic);
+  power.update(true, 0);
+  heapMonitor.startCycle();
+  timerTask.t_start(idRobotTask);
+  timerTask.t_start(idEndRobotTask);
+  writeLogs(event);
+}
+
+// Monostable du calendrier, armé pour le prochain nettoyage programmé
+// Le contexte est l'état du cycle (cleanCycle)
+void scheduleCleanTask(void* context) {
+  CleanCycle* cycle = (CleanCycle*)context;
+  if (wallClock.isSynced()) {
+    uint32_t now = wallClock.utc();
+    // Première échéance calculée dès que l'heure est connue
+    if (calendar.getNextRun() == 0)
+      calendar.plan(now);
+    if (calendar.fire(now)) {
+      const DateTime* date = wallClock.now();
+      startCycle(EV_START_SCHEDULED);
+      sprintf(bufferTime, "%02d:%02d\r", date->hour, date->minute);
+      outbox.post(TOPIC_SCHEDULED, bufferTime);
+      cycle->scheduled = true;
     }
   }
+  armCalendar();
+}
+
+// Lire le calendrier enregistré
+void initCalendar() {
+  char text[CALENDAR_TEXT_MAX];
+  FileLittleFS file(CALENDAR_FILE_NAME);
+  calendar.begin();
+  if (file.openRead()) {
+    int length = file.readLine(text, sizeof(text));
+    file.close();
+    calendar.parse(text, length);
+  }
+}
+
+// Timer écrivant périodiquement les logs en attente du journal (contexte)
+void logFlushTask(void* context) {
+  ((LogStore*)context)->flush();
+}
+
+// Timer relevant l'état du tas (contexte : moniteur)
+void heapTask(void* context) {
+  ((HeapMonitor*)context)->sample();
 }
 
 // Executé au boot
 void setup() {
   Serial.begin(115200);
 
-  pinMode(GPIO2_FORWARD, OUTPUT);
-  pinMode(GPIO0_RETURN, OUTPUT);
-  digitalWrite(GPIO2_FORWARD, HIGH);
-  digitalWrite(GPIO0_RETURN, HIGH);
+  relay.begin(GPIO2_FORWARD, GPIO0_RETURN);
   // Permet de vérifier que le serveur ntp fourni l'heure
   strcpy(date, "00/00/00 00:00:00");
-  fileParam = initFileParam(FORCE);
+  uint16_t corrected = initFileParam(FORCE);
   Serial.println(tabParam);
-  fileLog = new FileLittleFS(LOG_FILE_NAME);
+  // Journal circulaire, l'ancien fichier de logs est relu en tête
+  logStore.begin(LOG_FILE_NAME);
 
   initWifiStation();
   initMQTTClient();
 
-  ntpTime = new NTPClient(ntpUDP, "pool.ntp.org", 3600*2, 6000);
-  ntpTime->begin();
+  // Heure UTC synchronisée par wallClock, heure locale CET/CEST
+  wallClock.begin(&ntpUDP, CLOCK_NTP_SERVER);
   Serial.println(getDate());
-  logsWrite(bootRaison());
+  logsWrite(EV_BOOT, ESP.getResetInfoPtr()->reason);
+  if (corrected)
+    logsWrite(EV_PARAM_MIGRATED, corrected);
+  Serial.println(bootRaison());
 
-  setParam(tabParam);
+  setParam(&params);
   // debugPrintParam();
-  // Effacer les logs si supérieur à 4K octets
-  fileLog->purge(4048);
   
   // Création des tâches
   // Tache rythmée de nettoyage
   randomSeed(analogRead(A0));
-  idRobotTask = timerTask.t_creer(robotTask, random(minRandom_av, maxRandom_av), true);
+  idRobotTask = timerTask.t_creer(robotTask, &cleanCycle, random(minRandom_av * 1000L, maxRandom_av * 1000L), true);
 
   // Monostable déclenchant la fin du nettoyage après activeTime * 60 secondes
-  idEndRobotTask = timerTask.t_creer(robotEndTask, activeTime * 60, false);
+  idEndRobotTask = timerTask.t_creer(robotEndTask, &cleanCycle, activeTime * 60000UL, false);
 
-  // Tache rytmmée toute les 60 secondes, utilisée pour déclancher le nettoyage programmé 
-  idScheduleCleanTask = timerTask.t_creer(scheduleCleanTask, 60, true);
-  timerTask.t_start(idScheduleCleanTask);
+  // Écriture périodique en flash des logs en attente
+  idLogFlushTask = timerTask.t_creer(logFlushTask, &logStore, LOG_FLUSH_PERIOD, true);
+  timerTask.t_start(idLogFlushTask);
 
-  mqttClient.publish(TOPIC_RESET_CYCLE, "");
-  Serial.println("Robot piscine V" + version);
-  Serial.println(getDate());
-  currentRandomValue = random(minRandom_av, maxRandom_av);
+  // Relevé périodique du tas, l'état avant le dernier reset est relu
+  heapMonitor.begin();
+  idHeapTask = timerTask.t_creer(heapTask, &heapMonitor, HEAP_SAMPLE_PERIOD, true);
+  timerTask.t_start(idHeapTask);
 
-  // Serial.println(tabParam);
-  // Serial.println("New param");
-  // Serial.println(modifyParam(tabParam, "1", REVERSE));
+  // Monostable déclenchant le prochain nettoyage programmé du calendrier
+  initCalendar();
+  idScheduleCleanTask = timerTask.t_creer(scheduleCleanTask, &cleanCycle, CALENDAR_RETRY, false);
+  planCalendar();
+  // Détection des échéances indépendante des appels réseau bloquants
+  schedulerTicker.attach_ms(TIMER_TIC, Task::tic);
+
+  Serial.printf("Robot piscine V%s\n", version);
+  Serial.println(getDate());
+  cleanCycle.randomValue = random(minRandom_av * 1000L, maxRandom_av * 1000L);
 }
 
 void deleteLogs() {
-  fileLog->deleteFile();
+  logStore.clear();
+  logSending = false;
+}
+
+// Ligne line du diagnostic dans buffer (DIAG_TEXT_MAX octets)
+// Retourne sa longueur, 0 pour une ligne sans objet
+int formatDiag(unsigned line, char* buffer) {
+  const HeapStat* heap = heapMonitor.getLast();
+  const HeapStat* worst = heapMonitor.getWorst();
+  const HeapRecord* previous = heapMonitor.getPrevious();
+  switch (line) {
+  case 0:
+    return sprintf(buffer, "net:reconnect=%u;offline=%lus;lastReconnect=%lums",
+      connection.getReconnectCount(),
+      connection.getOfflineTime() / 1000,
+      connection.getLastReconnectTime());
+  case 1:
+    return sprintf(buffer, "mqtt:depth=%u;maxDepth=%u;sent=%lu;retries=%u;drops=%u;coalesced=%u",
+      outbox.getDepth(),
+      outbox.getMaxDepth(),
+      outbox.getSent(),
+      outbox.getRetries(),
+      outbox.getDrops(),
+      outbox.getCoalesced());
+  case 2:
+    return sprintf(buffer, "log:flush=%u;savedOpens=%u;savedBytes=%lu;pending=%u",
+      logStore.getFlushCount(),
+      logStore.getSavedOpens(),
+      logStore.getSavedBytes(),
+      logStore.getBuffered());
+  case 3:
+    return sprintf(buffer, "power:state=%u;active=%lus;modem=%lus;light=%lus;wake=%u",
+      power.getState(),
+      power.getTime(P_ACTIVE) / 1000,
+      power.getTime(P_MODEM) / 1000,
+      power.getTime(P_LIGHT) / 1000,
+      power.getWakeCount());
+  case 4:
+    return sprintf(buffer, "heap:free=%lu;maxBlock=%lu;frag=%lu%%;minFree=%lu;minBlock=%lu;maxFrag=%lu%%",
+      (unsigned long)heap->freeHeap, (unsigned long)heap->maxBlock, (unsigned long)heap->fragmentation,
+      (unsigned long)worst->freeHeap, (unsigned long)worst->maxBlock, (unsigned long)worst->fragmentation);
+  case 5:
+    worst = heapMonitor.getCycle();
+    return sprintf(buffer, "heapCycle:minFree=%lu;minBlock=%lu;maxFrag=%lu%%",
+      (unsigned long)worst->freeHeap, (unsigned long)worst->maxBlock, (unsigned long)worst->fragmentation);
+  case 6:
+    // État du tas avant le dernier reset
+    if (!previous)
+      return 0;
+    return sprintf(buffer, "heapBoot:uptime=%lus;free=%lu;maxBlock=%lu;frag=%lu%%;minFree=%lu;minBlock=%lu;restart=%s",
+      (unsigned long)previous->uptime,
+      (unsigned long)previous->last.freeHeap, (unsigned long)previous->last.maxBlock,
+      (unsigned long)previous->last.fragmentation,
+      (unsigned long)previous->worst.freeHeap, (unsigned long)previous->worst.maxBlock,
+      previous->deliberate ? "deliberate" : bootRaison());
+  case 7:
+    return sprintf(buffer, "clock:synced=%d;syncInterval=%lus;correction=%ldms;drift=%ldppm",
+      wallClock.isSynced(),
+      wallClock.getSyncInterval() / 1000,
+      wallClock.getLastCorrection(),
+      wallClock.getDrift());
+  }
+  return 0;
+}
+
+// Publier les métriques de diagnostic (envoi par pumpReplies)
+void publishDiag() {
+  diagLine = 0;
+  diagSending = true;
+}
+
+// Publier le calendrier et la date du prochain nettoyage programmé
+void publishCalendar() {
+  char buffer[CALENDAR_TEXT_MAX + 30];
+  DateTime next;
+  int n = calendar.format(buffer, CALENDAR_TEXT_MAX);
+  if (calendar.getNextRun() != 0) {
+    epochToDateTime(calendar.getNextRun(), &next);
+    n += sprintf(buffer + n, "#next=");
+    formatDateTime(&next, buffer + n, sizeof(buffer) - n);
+  }
+  outbox.post(TOPIC_CALENDAR, buffer, OB_STATE);
+}
+
+// Relever l'état du robot pour la trame TOPIC_STATE (voir status.h)
+void readStatus(StatusFrame* frame) {
+  int status = timerTask.getStatus(idRobotTask);
+  frame->cycle = cleanCycle.count;
+  frame->cycles = nbCycles;
+  frame->run = status == CREE ? ST_STOPPED : status == SUSP ? ST_SUSPENDED : ST_RUNNING;
+  frame->total = timerTask.getStartTime(idEndRobotTask) / 60000;
+  frame->elapsed = 0;
+  frame->legStart = 0;
+  frame->legTotal = 0;
+  if (frame->run != ST_STOPPED) {
+    frame->elapsed = timerTask.getCurrentTime(idEndRobotTask) / 60000;
+    frame->legStart = cleanCycle.legStart;
+    frame->legTotal = cleanCycle.randomValue / 1000;
+  }
+  // Direction est inversé après execution de robotTask
+  frame->forward = cleanCycle.direction;
+  frame->scheduled = cleanCycle.scheduled ? calendar.getLastRun() : 0;
+  frame->nextRun = calendar.getNextRun();
+}
+
+// Publier la trame d'état lorsqu'un champ a changé, au plus
+// toutes les STATUS_MIN_INTERVAL ms
+void statusUpdate() {
+  if (!statusPublisher.due())
+    return;
+  StatusFrame frame;
+  readStatus(&frame);
+  statusPublisher.update(&frame);
 }
 
 /*
- * Publier régulièrement les états afin de réfléter l'opération
- * en cours sur le smartphone même en cas connexion/reconnexion
- * de ce dernier.
+ * Publier l'état sur demande (TOPIC_GET_STATUS). La trame TOPIC_STATE
+ * étant retenue par le courtier, l'application la reçoit aussi à la
+ * connexion sans requête.
 */
 void publishState() {
-  static char buffer[60];
-  char randomBuffer[60];
+  StatusFrame frame;
+  readStatus(&frame);
+  statusPublisher.publish(&frame);
+#if STATUS_LEGACY_PUSH
+  // Anciennes versions de l'application
+  char buffer[60];
   sprintf(buffer, "Cycle %d/%d, t=%u/%u mn#%d",
-    currentCycle,
+    cleanCycle.count,
     nbCycles,
-    timerTask.getCurrentTime(idEndRobotTask) / 60,
-    timerTask.getStartTime(idEndRobotTask) / 60,
+    timerTask.getCurrentTime(idEndRobotTask) / 60000,
+    timerTask.getStartTime(idEndRobotTask) / 60000,
     timerTask.getStatus(idRobotTask) != CREE);
-  mqttClient.publish(TOPIC_STATUS, buffer);  
-  // Direction est inversé après execution de robotTask
-  if (direction) {
-    sprintf(randomBuffer, "AV %u/%u", timerTask.getCurrentTime(idRobotTask), currentRandomValue);
+  outbox.post(TOPIC_STATUS, buffer, OB_STATE);
+  sprintf(buffer, "%s %u/%u", cleanCycle.direction ? "AV" : "AR",
+    timerTask.getCurrentTime(idRobotTask) / 1000, cleanCycle.randomValue / 1000);
+  outbox.post(TOPIC_CYCLE_TIME, buffer);
+  if (cleanCycle.scheduled)
+    outbox.post(TOPIC_SCHEDULED, bufferTime);
+#endif
+}
+
+/*
+ * Envoi des logs en cours (TOPIC_GET_LOGS)
+ * L'implémentation MQTT pour l'esp8266 limite la taille des messages.
+ * Chaque paquet contient autant de lignes entières que le permet le
+ * buffer de PubSubClient. LOG_PACKETS_PER_LOOP paquets sont envoyés par
+ * passage dans loop afin de ne pas affamer l'ordonnanceur et les relais.
+ * Les paquets passent par la file d'émission : la lecture s'interrompt
+ * tant qu'elle n'a pas la place d'un paquet et du message de fin.
+ * Le message "#####" termine l'envoi.
+ */
+void pumpLogs() {
+  static char packet[LOG_PACKET_MAX];
+  if (!logSending)
+    return;
+  // Place disponible : buffer moins en-tête fixe, longueur et topic
+  unsigned capacity = mqttClient.getBufferSize() - 7 - strlen(TOPIC_READ_LOGS);
+  if (capacity > sizeof(packet))
+    capacity = sizeof(packet);
+  if (capacity > OUTBOX_PAYLOAD_MAX + 1)
+    capacity = OUTBOX_PAYLOAD_MAX + 1;
+  for (int n = 0; n < LOG_PACKETS_PER_LOOP && outbox.getFree() >= 2; n++) {
+    unsigned length = 0;
+    // Ligne lue au paquet précédent et qui n'y tenait pas
+    if (logLine[0] == 0)
+      logStore.readLine(logLine, sizeof(logLine));
+    while (logLine[0] != 0) {
+      unsigned lineLength = strlen(logLine);
+      // Une ligne est toujours envoyée, même seule dans un paquet trop petit
+      if (length > 0 && length + lineLength >= capacity)
+        break;
+      memcpy(packet + length, logLine, lineLength);
+      length += lineLength;
+      logStore.readLine(logLine, sizeof(logLine));
+    }
+    packet[length] = 0;
+    if (length > 0)
+      outbox.post(TOPIC_READ_LOGS, packet);
+    if (logLine[0] == 0) {
+      // Message de fin
+      logStore.close();
+      outbox.post(TOPIC_READ_LOGS, "#####");
+      logSending = false;
+      return;
+    }
   }
-  else {
-    sprintf(randomBuffer, "AR %u/%u", timerTask.getCurrentTime(idRobotTask), currentRandomValue);
-  }  
-  mqttClient.publish(TOPIC_CYCLE_TIME, randomBuffer);
-  if (activeScheduledTask)
-    mqttClient.publish(TOPIC_SCHEDULED, bufferTime);
 }
 
-// Boucle de scrutation
-void loop() {
-  static  long tps = 0;
-  static  int wifiTest = 0;
-  // Vérifier la connexion WiFI et reconnecter le cas échéant
-  while (WiFi.waitForConnectResult() != WL_CONNECTED) {
-    WiFi.reconnect();
-    delay(5000);
-    if (wifiTest++ == 6) {
-      ESP.restart();
+// Poursuivre l'envoi du diagnostic et du profil, un message par ligne ou
+// section, tant que la file d'émission garde une place pour les messages
+// d'événement : une requête ne peut pas la saturer
+void pumpReplies() {
+  char buffer[DIAG_TEXT_MAX];
+  while (diagSending && outbox.getFree() >= 2) {
+    if (formatDiag(diagLine, buffer) > 0)
+      outbox.post(TOPIC_DIAG, buffer);
+    if (++diagLine == DIAG_LINES)
+      diagSending = false;
+  }
+  while (profileSending && outbox.getFree() >= 2) {
+    profiler.format(profileSection, buffer, sizeof(buffer));
+    outbox.post(TOPIC_PROFILE, buffer);
+    if (++profileSection == PROFILE_SECTIONS) {
+      profileSending = false;
+      if (profileReset)
+        profiler.reset();
     }
   }
+}
+
+// Gestion de l'énergie en fin de boucle (voir power.h)
+// Au repos le Ticker est ralenti, les échéances étant aussi détectées
+// par schedule() à chaque réveil. Les messages en attente d'émission
+// maintiennent l'état actif tant que le courtier est joignable.
+void powerUpdate() {
+  boolean busy = timerTask.getStatus(idRobotTask) != CREE
+    || relay.getState() != R_OFF || relay.getRequest() != R_OFF
+    || logSending || diagSending || profileSending
+    || (outbox.getDepth() > 0 && connection.isConnected());
+  if (busy != (power.getState() == P_ACTIVE))
+    schedulerTicker.attach_ms(busy ? TIMER_TIC : TIMER_IDLE_TIC, Task::tic);
+  power.update(busy, timerTask.idleTime());
+}
+
+// Boucle de scrutation
+// Chaque section est chronométrée par profiler (voir profile.h)
+void loop() {
+  uint32_t start = ESP.getCycleCount();
+  uint32_t t;
   // Reset du chien de garde  
   ESP.wdtFeed();
-
-  if (!mqttClient.connected()) {
-    initMQTTClient();
-  }
+  // Suivre les connexions WiFi et MQTT sans bloquer la boucle
+  connection.update();
+  // Resynchroniser l'horloge lorsque l'intervalle NTP est écoulé
+  wallClock.update();
+  t = profiler.lap(PS_NETWORK, start);
   // Alimenter les boucles de messages
   ArduinoOTA.handle();
+  t = profiler.lap(PS_OTA, t);
   mqttClient.loop();
-
-  // Mettre à jour le scheduler toutes les s
-  if (millis() - tps > TIMER_TIC) {
-    tps = millis();
-    timerTask.schedule();
-  }
+  t = profiler.lap(PS_MQTT, t);
+
+  // Exécuter les tâches arrivées à échéance (y compris celles
+  // détectées par le Ticker pendant un blocage réseau)
+  timerTask.schedule();
+  t = profiler.lap(PS_SCHEDULE, t);
+  // Faire progresser la séquence des relais
+  relay.update();
+  t = profiler.lap(PS_RELAY, t);
+  // Poursuivre l'envoi des logs, du diagnostic et du profil
+  pumpLogs();
+  pumpReplies();
+  t = profiler.lap(PS_LOGS, t);
+  // Republier la trame d'état si elle a changé
+  statusUpdate();
+  // Publier les messages en attente
+  outbox.drain();
+  profiler.lap(PS_PUBLISH, t);
+  profiler.lap(PS_LOOP, start);
+  // Veille jusqu'à la prochaine échéance si rien n'est en cours
+  powerUpdate();
 }
 
-// Fonction de rappel MQTT
-// Appelé à la réception d'un message abonné
-void PubSubCallback(char* topic, byte* payload, unsigned int length) {
-  String strPayload = "";
-  static String strON = "ON";
-  static String strOFF = "OFF";
-  static String strSTOP = "STOP";
+// Traitement des messages MQTT
+// Chaque gestionnaire reçoit une vue (pointeur, longueur) sur le message,
+// sans copie ni allocation. Le message n'est pas terminé par un zéro.
 
-  for (unsigned int i = 0; i < length; i++) {
-    strPayload += (char)payload[i];
-  }
+// Comparer le message à une chaine constante
+inline boolean payloadIs(const char* payload, unsigned length, const char* s) {
+  return strlen(s) == length && memcmp(payload, s, length) == 0;
+}
 
-  // Serial.print("Topic:");
-  // Serial.println(topic);
-  // Serial.print("Message:");
-
-  //------------------- TOPIC_SET_PARAM -----------------
-  if (strcmp(topic, TOPIC_SET_PARAM) == 0) {
-    strcpy(tabParam, strPayload.c_str());
-    fileParam->writeFile(tabParam, "w");
-    setParam(tabParam);
-    // Serial.println(tabParam);
-    // setParam met à jour activeTime
-    // Réactualiser le temps de fonctionnement du robot si modifié
-    timerTask.setStartTime(idEndRobotTask, activeTime * 60);
-    return;
-  }
-  //------------------- TOPIC_GET_PARAM ----------------
-  if (strcmp(topic, TOPIC_GET_PARAM) == 0) {
-    // Serial.println(tabParam);
-    mqttClient.publish(TOPIC_PARAM, tabParam);
-    if (currentCycle!=0)
-      mqttClient.publish(TOPIC_CYCLE_TIME, randomBuffer);
-    else
-      mqttClient.publish(TOPIC_CYCLE_TIME, "0");
+//------------------- TOPIC_SET_PARAM -----------------
+void onSetParam(const char* payload, unsigned length) {
+  Params newParams = params;
+  // Message ignoré si un champ manque ou est hors bornes
+  if (!paramParse(payload, length, &newParams))
     return;
-  }
-  //------------------ TOPIC_GET_VERSION ----------------
-  else if (strcmp(topic, TOPIC_GET_VERSION) == 0) {
-    static char buffer[50];
-    sprintf(buffer, "%s;%s", version.c_str(), WiFi.localIP().toString().c_str());
-    mqttClient.publish(TOPIC_READ_VERSION, buffer);
+  applyParams(&newParams);
+}
+
+//------------------- TOPIC_PATCH_PARAM -----------------
+// Modification partielle "nom=valeur;nom=valeur" (noms de paramSchema)
+void onPatchParam(const char* payload, unsigned length) {
+  Params newParams = params;
+  if (!paramParsePatch(payload, length, &newParams))
     return;
-  }
-  //------------------ TOPIC_GET_LOGS ----------------
-  else if (strcmp(topic, TOPIC_GET_LOGS) == 0) {
-    // L'implémentation MQTT pour l'esp8266 limite la taille
-    // des messages. Il faut les envoyer ligne par ligne
-    String logs = fileLog->readFile();
-    fileLog->close();
-    unsigned i = 0;
-    while (i < logs.length()) {
-      String partial = logs.substring(i, logs.indexOf("\n", i) + 1);
-      mqttClient.publish(TOPIC_READ_LOGS, partial.c_str());
-      i = logs.indexOf("\n", i) + 1;
-    }
-    // Message de fin
-    mqttClient.publish(TOPIC_READ_LOGS, "#####");
+  applyParams(&newParams);
+}
+
+//------------------- TOPIC_GET_PARAM ----------------
+void onGetParam(const char*, unsigned) {
+  // Serial.println(tabParam);
+  outbox.post(TOPIC_PARAM, tabParam, OB_STATE);
+  if (cleanCycle.count!=0)
+    outbox.post(TOPIC_CYCLE_TIME, randomBuffer);
+  else
+    outbox.post(TOPIC_CYCLE_TIME, "0");
+}
+
+//------------------ TOPIC_GET_VERSION ----------------
+void onGetVersion(const char*, unsigned) {
+  char buffer[50];
+  IPAddress ip = WiFi.localIP();
+  sprintf(buffer, "%s;%u.%u.%u.%u", version, ip[0], ip[1], ip[2], ip[3]);
+  outbox.post(TOPIC_READ_VERSION, buffer, OB_STATE);
+}
+
+//------------------ TOPIC_GET_LOGS ----------------
+void onGetLogs(const char*, unsigned) {
+  // L'envoi est réparti sur plusieurs passages dans loop (pumpLogs)
+  logStore.flush();
+  logSending = logStore.openRead();
+  logLine[0] = 0;
+  if (!logSending)
+    outbox.post(TOPIC_READ_LOGS, "#####");
+}
+
+//------------------ TOPIC_GET_STATUS ----------------
+void onGetStatus(const char*, unsigned) {
+  publishState();
+}
+
+//------------------ TOPIC_GET_DIAG ----------------
+void onGetDiag(const char*, unsigned) {
+  publishDiag();
+}
+
+//------------------ TOPIC_SET_CALENDAR ----------------
+// Créneaux hebdomadaires "1111100 08:30;0000011 10:00" (voir calendar.h)
+// Un message vide revient au créneau quotidien des paramètres
+void onSetCalendar(const char* payload, unsigned length) {
+  char text[CALENDAR_TEXT_MAX];
+  if (length >= sizeof(text) || !calendar.parse(payload, length))
     return;
+  calendar.format(text, sizeof(text));
+  FileLittleFS file(CALENDAR_FILE_NAME);
+  file.writeFile(text, "w");
+  planCalendar();
+  publishCalendar();
+}
+
+//------------------ TOPIC_GET_CALENDAR ----------------
+void onGetCalendar(const char*, unsigned) {
+  publishCalendar();
+}
+
+//------------------ TOPIC_GET_PROFILE ----------------
+// Un message par section sur TOPIC_PROFILE, "RESET" remet ensuite
+// les histogrammes à zéro, une fois toutes les sections envoyées
+void onGetProfile(const char* payload, unsigned length) {
+  // L'envoi est réparti sur plusieurs passages dans loop (pumpReplies)
+  profileSection = 0;
+  profileReset = payloadIs(payload, length, "RESET");
+  profileSending = true;
+}
+
+//------------------ TOPIC_START ----------------
+void onStart(const char* payload, unsigned length) {
+  if (payloadIs(payload, length, "ON")) {
+    startCycle(EV_START_MANUAL);
   }
-  //------------------ TOPIC_GET_STATUS ----------------
-  else if (strcmp(topic, TOPIC_GET_STATUS) == 0) {
-    publishState();
-    return;
+  else {
+    robotEndTask(&cleanCycle);
+    outbox.post(TOPIC_CYCLE_TIME, "0");
   }
-  //------------------ TOPIC_START ----------------
-  else if (strcmp(topic, TOPIC_START) == 0) {
-    if (strPayload == strON) {
-      timerTask.t_start(idRobotTask);
-      timerTask.t_start(idEndRobotTask);
-      writeLogs("Start manual cycle");
+}
 
+//------------------ TOPIC_MANUAL ----------------
+void onManual(const char* payload, unsigned length) {
+  static boolean b;
+  // timerTask.printStatus(idRobotTask);
+  if (cleanCycle.count==0) {
+    timerTask.t_stop(idRobotTask);
+    timerTask.t_stop(idEndRobotTask);
+    // Les commandes rapprochées sont fusionnées par relay
+    if (payloadIs(payload, length, "ON")) {
+      robotForward();
+    }
+    else if (payloadIs(payload, length, "OFF")) {
+      robotReturn();
     }
     else {
-      robotEndTask();
-      mqttClient.publish(TOPIC_CYCLE_TIME, "0");
+      powerOff();
     }
-    return;
   }
-  //------------------ TOPIC_MANUAL ----------------
-  else if (strcmp(topic, TOPIC_MANUAL) == 0) {
-    static boolean b;
-    // timerTask.printStatus(idRobotTask);
-    if (currentCycle==0) {
-      timerTask.t_stop(idRobotTask);
-      timerTask.t_stop(idEndRobotTask);
-      if (strPayload == strON) {
-        robotForward();
-        delay(2000);
-        }
-      else if (strPayload == strOFF) {
-        robotReturn();
-        delay(2000);
-      }
-      else {
+  else {
+    if (payloadIs(payload, length, "STOP")) {
+      if (!b) {
+        timerTask.t_suspend(idRobotTask);
         powerOff();
       }
-    }
-    else {
-      if (strPayload == strSTOP) {
-        if (!b) {
-          timerTask.t_suspend(idRobotTask);
-          powerOff();
+      else {
+        // Serial.println("resume");
+        timerTask.t_resume(idRobotTask);
+        // Début du mouvement décalé de la durée de la suspension
+        cleanCycle.legStart = wallClock.utc() - timerTask.getCurrentTime(idRobotTask) / 1000;
+        if (!cleanCycle.direction) {
+          robotForward();
         }
         else {
-          // Serial.println("resume");
-          timerTask.t_resume(idRobotTask);
-          if (!direction) {
-            robotForward();
-          }
-          else {
-            robotReturn();
-          }
+          robotReturn();
         }
-        b = !b;
       }
+      b = !b;
     }
-    return;
-  }
-  //------------------ TOPIC_DELETE_LOGS ----------------
-  else if (strcmp(topic, TOPIC_DELETE_LOGS) == 0) {
-    deleteLogs();
   }
-  //------------------  TOPIC_RESET ----------------------
-  if (cmp(topic, TOPIC_RESET)) {
-    ESP.restart();
+}
+
+//------------------ TOPIC_DELETE_LOGS ----------------
+void onDeleteLogs(const char*, unsigned) {
+  deleteLogs();
+}
+
+//------------------  TOPIC_RESET ----------------------
+void onReset(const char*, unsigned) {
+  logStore.flush();
+  heapMonitor.snapshot();
+  ESP.restart();
+}
+
+// Table de dispatch des messages abonnés
+// Les topics sont identifiés par leur suffixe après TOPIC_BASE.
+// La table doit rester triée par ordre strcmp des suffixes
+// (vérifié à la compilation), la recherche est dichotomique.
+struct Command {
+  const char* suffix;
+  void (*handler)(const char* payload, unsigned length);
+};
+
+#define SUFFIX(topic) ((topic) + sizeof(TOPIC_BASE) - 1)
+
+constexpr Command commands[] = {
+  { SUFFIX(TOPIC_GET_CALENDAR), onGetCalendar },
+  { SUFFIX(TOPIC_SET_CALENDAR), onSetCalendar },
+  { SUFFIX(TOPIC_GET_DIAG),    onGetDiag },
+  { SUFFIX(TOPIC_GET_STATUS),  onGetStatus },
+  { SUFFIX(TOPIC_DELETE_LOGS), onDeleteLogs },
+  { SUFFIX(TOPIC_GET_LOGS),    onGetLogs },
+  { SUFFIX(TOPIC_MANUAL),      onManual },
+  { SUFFIX(TOPIC_GET_PARAM),   onGetParam },
+  { SUFFIX(TOPIC_PATCH_PARAM), onPatchParam },
+  { SUFFIX(TOPIC_SET_PARAM),   onSetParam },
+  { SUFFIX(TOPIC_GET_PROFILE), onGetProfile },
+  { SUFFIX(TOPIC_RESET),       onReset },
+  { SUFFIX(TOPIC_START),       onStart },
+  { SUFFIX(TOPIC_GET_VERSION), onGetVersion },
+};
+constexpr int N_COMMANDS = sizeof(commands) / sizeof(commands[0]);
+
+constexpr int constStrcmp(const char* a, const char* b) {
+  return (*a != *b || *a == 0) ? (unsigned char)*a - (unsigned char)*b : constStrcmp(a + 1, b + 1);
+}
+constexpr boolean commandsSorted(int i) {
+  return i >= N_COMMANDS - 1 ||
+    (constStrcmp(commands[i].suffix, commands[i + 1].suffix) < 0 && commandsSorted(i + 1));
+}
+static_assert(commandsSorted(0), "commands[] doit être trié par suffixe");
+
+// Fonction de rappel MQTT
+// Appelé à la réception d'un message abonné
+void PubSubCallback(char* topic, byte* payload, unsigned int length) {
+  // Serial.print("Topic:");
+  // Serial.println(topic);
+  if (strncmp(topic, TOPIC_BASE, sizeof(TOPIC_BASE) - 1) != 0)
     return;
+  const char* suffix = SUFFIX(topic);
+  int low = 0;
+  int high = N_COMMANDS - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    int c = strcmp(suffix, commands[mid].suffix);
+    if (c == 0) {
+      commands[mid].handler((const char*)payload, length);
+      return;
+    }
+    if (c < 0)
+      high = mid - 1;
+    else
+      low = mid + 1;
   }
-}
\ No newline at end of file
+}
@@ -0,0 +1,149 @@
+/**
+ * @file outbox.cpp
+ * @brief Bounded outbound MQTT queue with retry and coalescing.
+ *
+ * Every publication is copied into a fixed ring of OUTBOX_LEN messages and sent from loop() by
+ * drain(), a few messages per pass, once the client is connected. A message leaves the ring
+ * only when the client accepted it, so that nothing is lost while the broker is unreachable.
+ * Event messages are sent in order and retried after a failure; a state message replaces the
+ * pending message of the same topic.
+ */
+#include "outbox.h"
+
+Outbox::Outbox() {
+  client = NULL;
+  head = 0;
+  count = 0;
+  nextAttempt = 0;
+  maxDepth = 0;
+  sent = 0;
+  retries = 0;
+  drops = 0;
+  coalesced = 0;
+}
+
+void Outbox::begin(PubSubClient &client) {
+  this->client = &client;
+}
+
+/**
+ * @brief Queues a message.
+ *
+ * @param topic Topic, which must stay valid until the message is sent (constant of const.h).
+ * @param payload Message, copied.
+ * @param flags OB_EVENT or OB_STATE, plus OB_RETAIN for a retained message.
+ * @return false if the message is dropped (queue full or message too long).
+ */
+boolean Outbox::post(const char *topic, const char *payload, uint8_t flags) {
+  unsigned length = strlen(payload);
+  if (length > OUTBOX_PAYLOAD_MAX) {
+    drops++;
+    return false;
+  }
+  Message *message = NULL;
+  if (flags & OB_STATE) {
+    // Remplacer la valeur encore en attente
+    for (unsigned i = 0; i < count; i++) {
+      Message *m = &queue[(head + i) % OUTBOX_LEN];
+      if ((m->flags & OB_STATE) && strcmp(m->topic, topic) == 0) {
+        message = m;
+        coalesced++;
+        break;
+      }
+    }
+  }
+  if (message == NULL) {
+    if (count == OUTBOX_LEN) {
+      drops++;
+      return false;
+    }
+    message = &queue[(head + count) % OUTBOX_LEN];
+    count++;
+    if (count > maxDepth)
+      maxDepth = count;
+  }
+  message->topic = topic;
+  message->flags = flags;
+  message->retries = 0;
+  message->length = length;
+  memcpy(message->payload, payload, length);
+  return true;
+}
+
+/**
+ * @brief Publishes up to OUTBOX_PER_LOOP queued messages. Called from loop().
+ *
+ * Sending stops at the first failure so that the order is kept; the failed message is tried
+ * again after OUTBOX_RETRY_DELAY ms, then dropped after OUTBOX_MAX_RETRY attempts.
+ */
+void Outbox::drain() {
+  if (count == 0 || client == NULL || !client->connected())
+    return;
+  unsigned long now = millis();
+  if ((long)(now - nextAttempt) < 0)
+    return;
+  for (unsigned n = 0; n < OUTBOX_PER_LOOP && count > 0; n++) {
+    Message *m = &queue[head];
+    if (!client->publish(m->topic, (const uint8_t *)m->payload, m->length, m->flags & OB_RETAIN)) {
+      nextAttempt = now + OUTBOX_RETRY_DELAY;
+      if (++m->retries < OUTBOX_MAX_RETRY) {
+        retries++;
+        return;
+      }
+      drops++;
+    }
+    else
+      sent++;
+    head = (head + 1) % OUTBOX_LEN;
+    count--;
+  }
+}
+
+/**
+ * @brief Number of messages waiting.
+ */
+unsigned Outbox::getDepth() {
+  return count;
+}
+
+/**
+ * @brief Number of free places in the queue.
+ */
+unsigned Outbox::getFree() {
+  return OUTBOX_LEN - count;
+}
+
+/**
+ * @brief Highest number of messages waiting since boot.
+ */
+unsigned Outbox::getMaxDepth() {
+  return maxDepth;
+}
+
+/**
+ * @brief Number of messages published.
+ */
+unsigned long Outbox::getSent() {
+  return sent;
+}
+
+/**
+ * @brief Number of failed publications tried again.
+ */
+unsigned Outbox::getRetries() {
+  return retries;
+}
+
+/**
+ * @brief Number of messages dropped (queue full, too long or too many failures).
+ */
+unsigned Outbox::getDrops() {
+  return drops;
+}
+
+/**
+ * @brief Number of state messages replaced before being sent.
+ */
+unsigned Outbox::getCoalesced() {
+  return coalesced;
+}
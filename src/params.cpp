@@ -0,0 +1,350 @@
+/**
+ * @file params.cpp
+ * @brief Versioned, CRC-protected binary parameter store with A/B slots.
+ *
+ * Each save writes a complete ParamRecord to the slot that does not hold the most recent
+ * valid record, so the previous parameters stay intact until the new record is committed.
+ * At boot paramLoad() reads both slots and keeps the valid record with the highest sequence
+ * number.
+ */
+#include "params.h"
+#include "files.h"
+
+// Slot contenant l'enregistrement valide le plus récent (0 : A, 1 : B), -1 aucun
+int paramSlot = -1;
+uint16_t paramSequence = 0;
+
+/**
+ * @brief CRC-16/CCITT-FALSE of a buffer.
+ */
+uint16_t crc16(const uint8_t *data, unsigned length) {
+  uint16_t crc = 0xffff;
+  while (length--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+/**
+ * @brief Reads and validates the record of a slot.
+ *
+ * @return true if the slot holds a record with the right magic, version, size and CRC.
+ */
+boolean readSlot(const char *name, ParamRecord *record) {
+  File file = LittleFS.open(name, "r");
+  if (!file)
+    return false;
+  unsigned n = file.read((uint8_t *)record, sizeof(ParamRecord));
+  file.close();
+  return n == sizeof(ParamRecord)
+    && record->magic == PARAM_MAGIC
+    && record->version == PARAM_VERSION
+    && record->size == sizeof(Params)
+    && record->crc == crc16((const uint8_t *)record, offsetof(ParamRecord, crc));
+}
+
+/**
+ * @brief Loads the most recent valid parameter record.
+ *
+ * @param params Structure filled with the stored parameters.
+ * @return false if no valid record exists (first boot or former text format).
+ */
+boolean paramLoad(Params *params) {
+  ParamRecord a, b;
+  FileLittleFS::connectFs();
+  boolean validA = readSlot(PARAM_SLOT_A, &a);
+  boolean validB = readSlot(PARAM_SLOT_B, &b);
+  if (validA && validB) {
+    // Comparaison de séquences tolérant le rebouclage
+    validA = (int16_t)(a.sequence - b.sequence) > 0;
+    validB = !validA;
+  }
+  if (validA) {
+    *params = a.params;
+    paramSlot = 0;
+    paramSequence = a.sequence;
+    return true;
+  }
+  if (validB) {
+    *params = b.params;
+    paramSlot = 1;
+    paramSequence = b.sequence;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Commits the parameters to the slot not holding the current record.
+ *
+ * @return true if the record has been completely written.
+ */
+boolean paramSave(const Params *params) {
+  ParamRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = PARAM_MAGIC;
+  record.version = PARAM_VERSION;
+  record.size = sizeof(Params);
+  record.sequence = paramSequence + 1;
+  record.params = *params;
+  record.crc = crc16((const uint8_t *)&record, offsetof(ParamRecord, crc));
+  int slot = (paramSlot == 0) ? 1 : 0;
+  FileLittleFS::connectFs();
+  File file = LittleFS.open(slot == 0 ? PARAM_SLOT_A : PARAM_SLOT_B, "w");
+  if (!file) {
+    Serial.println("Echec de l'ouverture du fichier!");
+    return false;
+  }
+  unsigned n = file.write((const uint8_t *)&record, sizeof(record));
+  file.close();
+  if (n != sizeof(record)) {
+    Serial.println("Erreur ecriture");
+    return false;
+  }
+  paramSlot = slot;
+  paramSequence = record.sequence;
+  return true;
+}
+
+/**
+ * @brief Fills the structure with the default values of the schema.
+ */
+void paramDefaults(Params *params) {
+  for (int id = 0; id < PARAM_LEN; id++)
+    paramSet(params, id, paramSchema[id].defaultValue);
+}
+
+/**
+ * @brief Parses a decimal number of at most 6 characters, sign included.
+ *
+ * @return false if the text is empty or not a number.
+ */
+static boolean parseNumber(const char *text, unsigned length, long *value) {
+  long v = 0;
+  unsigned i = 0;
+  boolean negative = length > 0 && text[0] == '-';
+  if (negative)
+    i++;
+  if (i == length || length > 6)
+    return false;
+  for (; i < length; i++) {
+    if (text[i] < '0' || text[i] > '9')
+      return false;
+    v = v * 10 + (text[i] - '0');
+  }
+  *value = negative ? -v : v;
+  return true;
+}
+
+/**
+ * @brief Parses one field value and checks it against the schema bounds.
+ *
+ * @param id Field index.
+ * @param text Start of the value (not null-terminated).
+ * @param length Number of characters of the value.
+ * @param value Parsed value, only written on success.
+ * @return false if the value is empty, not a number or out of range.
+ */
+boolean paramParseField(int id, const char *text, unsigned length, int16_t *value) {
+  long v;
+  if (!parseNumber(text, length, &v))
+    return false;
+  if (v < paramSchema[id].min || v > paramSchema[id].max)
+    return false;
+  *value = (int16_t)v;
+  return true;
+}
+
+/**
+ * @brief Parses a colon-separated parameter string in place, without copy or allocation.
+ *
+ * @param text Parameter string (not necessarily null-terminated).
+ * @param length Length of the string.
+ * @param params Structure updated only if every field is present and valid.
+ * @return true if the string has been accepted.
+ */
+boolean paramParse(const char *text, unsigned length, Params *params) {
+  Params result;
+  unsigned start = 0;
+  // Tolérer une fin de ligne éventuelle
+  while (length > 0 && (text[length - 1] == '\r' || text[length - 1] == '\n' || text[length - 1] == ' '))
+    length--;
+  for (int id = 0; id < PARAM_LEN; id++) {
+    unsigned end = start;
+    while (end < length && text[end] != ':')
+      end++;
+    // Le dernier champ doit terminer la chaine, les autres être suivis de ':'
+    if ((id == PARAM_LEN - 1) != (end == length))
+      return false;
+    int16_t value;
+    if (!paramParseField(id, text + start, end - start, &value))
+      return false;
+    paramSet(&result, id, value);
+    start = end + 1;
+  }
+  *params = result;
+  return true;
+}
+
+/**
+ * @brief Migrates the former text string "1:10:30:..." field by field.
+ *
+ * A value out of the schema bounds is clamped, a missing or unreadable value is replaced by
+ * its default: an invalid field does not discard the others.
+ *
+ * @return Mask (1 << ParamId) of the fields clamped or set to their default value.
+ */
+uint16_t paramMigrate(const char *text, unsigned length, Params *params) {
+  uint16_t mask = 0;
+  unsigned start = 0;
+  while (length > 0 && (text[length - 1] == '\r' || text[length - 1] == '\n' || text[length - 1] == ' '))
+    length--;
+  paramDefaults(params);
+  for (int id = 0; id < PARAM_LEN; id++) {
+    unsigned end = start;
+    while (end < length && text[end] != ':')
+      end++;
+    long v;
+    if (start > length || !parseNumber(text + start, end - start, &v))
+      mask |= 1 << id;
+    else {
+      if (v < paramSchema[id].min || v > paramSchema[id].max) {
+        v = v < paramSchema[id].min ? paramSchema[id].min : paramSchema[id].max;
+        mask |= 1 << id;
+      }
+      paramSet(params, id, (int16_t)v);
+    }
+    start = end + 1;
+  }
+  return mask;
+}
+
+/**
+ * @brief Formats the parameters as the colon-separated string used by the Android app.
+ *
+ * @param buffer Destination.
+ * @param size Size of the destination.
+ * @return Length of the string.
+ */
+int paramFormat(const Params *params, char *buffer, unsigned size) {
+  int n = 0;
+  for (int id = 0; id < PARAM_LEN && n < (int)size; id++)
+    n += snprintf(buffer + n, size - n, id == 0 ? "%d" : ":%d", paramGet(params, id));
+  return n;
+}
+
+/**
+ * @brief Rewrites a single field of a formatted parameter string.
+ *
+ * Only the characters of the field are replaced, the tail of the string being moved when the
+ * width of the value changes.
+ *
+ * @param buffer Formatted parameter string, modified in place.
+ * @param size Size of the buffer.
+ * @param params Structure holding the new value.
+ * @param id Index of the modified field.
+ * @return false if the field is not found or the result does not fit.
+ */
+boolean paramPatch(char *buffer, unsigned size, const Params *params, int id) {
+  char value[8];
+  char *start = buffer;
+  for (int i = 0; i < id; i++) {
+    start = strchr(start, ':');
+    if (start == NULL)
+      return false;
+    start++;
+  }
+  char *end = strchr(start, ':');
+  if (end == NULL)
+    end = start + strlen(start);
+  unsigned oldLength = end - start;
+  unsigned newLength = snprintf(value, sizeof(value), "%d", paramGet(params, id));
+  unsigned length = strlen(buffer);
+  if (length - oldLength + newLength >= size)
+    return false;
+  // Déplacer la fin de chaine (zéro compris) puis écrire la valeur
+  memmove(start + newLength, end, buffer + length + 1 - end);
+  memcpy(start, value, newLength);
+  return true;
+}
+
+/**
+ * @brief Finds a field by its schema name.
+ *
+ * @return The field index, -1 if unknown.
+ */
+int paramFind(const char *name, unsigned length) {
+  for (int id = 0; id < PARAM_LEN; id++) {
+    if (strlen(paramSchema[id].name) == length && memcmp(paramSchema[id].name, name, length) == 0)
+      return id;
+  }
+  return -1;
+}
+
+/**
+ * @brief Mask of the fields (1 << ParamId) that differ between two parameter sets.
+ */
+uint16_t paramDiff(const Params *a, const Params *b) {
+  uint16_t mask = 0;
+  for (int id = 0; id < PARAM_LEN; id++) {
+    if (paramGet(a, id) != paramGet(b, id))
+      mask |= 1 << id;
+  }
+  return mask;
+}
+
+/**
+ * @brief Applies a patch "name=value;name=value" to a parameter set.
+ *
+ * The patch is applied only if every pair is well formed, names a known field and holds a
+ * value within the bounds of the schema.
+ *
+ * @param text Patch (not necessarily null-terminated).
+ * @param length Length of the patch.
+ * @param params Structure updated on success.
+ * @return true if the patch has been applied.
+ */
+boolean paramParsePatch(const char *text, unsigned length, Params *params) {
+  Params result = *params;
+  unsigned start = 0;
+  while (length > 0 && (text[length - 1] == '\r' || text[length - 1] == '\n' || text[length - 1] == ';'))
+    length--;
+  if (length == 0)
+    return false;
+  while (start < length) {
+    unsigned end = start;
+    unsigned equal = length;
+    while (end < length && text[end] != ';') {
+      if (text[end] == '=' && equal == length)
+        equal = end;
+      end++;
+    }
+    if (equal >= end)
+      return false;
+    int id = paramFind(text + start, equal - start);
+    int16_t value;
+    if (id < 0 || !paramParseField(id, text + equal + 1, end - equal - 1, &value))
+      return false;
+    paramSet(&result, id, value);
+    start = end + 1;
+  }
+  *params = result;
+  return true;
+}
+
+/**
+ * @brief Formats the fields of mask as "name=value;name=value".
+ *
+ * @return Length of the string.
+ */
+int paramFormatDelta(const Params *params, uint16_t mask, char *buffer, unsigned size) {
+  int n = 0;
+  buffer[0] = 0;
+  for (int id = 0; id < PARAM_LEN && n < (int)size; id++) {
+    if (mask & (1 << id))
+      n += snprintf(buffer + n, size - n, n == 0 ? "%s=%d" : ";%s=%d", paramSchema[id].name, paramGet(params, id));
+  }
+  return n;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file power.cpp
+ * @brief Idle power management between cleaning cycles.
+ *
+ * When the application is idle the WiFi modem is put in modem-sleep or light-sleep and loop()
+ * waits in delay() until the next task deadline, for at most POWER_MAX_LATENCY ms so that MQTT
+ * commands are still handled within that limit. Any activity switches back to the active state
+ * (no WiFi sleep). The time spent in each state is accumulated.
+ */
+#include <ESP8266WiFi.h>
+#include "power.h"
+
+Power::Power() {
+  state = P_ACTIVE;
+  since = 0;
+  for (unsigned i = 0; i < POWER_STATES; i++)
+    time[i] = 0;
+  wakeCount = 0;
+}
+
+/**
+ * @brief Switches the WiFi sleep mode and accumulates the time spent in the previous state.
+ */
+void Power::enter(unsigned state) {
+  if (state == this->state)
+    return;
+  unsigned long now = millis();
+  time[this->state] += now - since;
+  since = now;
+  if (state == P_ACTIVE) {
+    WiFi.setSleepMode(WIFI_NONE_SLEEP);
+    wakeCount++;
+  }
+  else {
+    // Nombre de balises entre deux écoutes du point d'accès (1..10)
+    unsigned listenInterval = POWER_MAX_LATENCY / POWER_BEACON_INTERVAL;
+    if (listenInterval < 1)
+      listenInterval = 1;
+    if (listenInterval > 10)
+      listenInterval = 10;
+    WiFi.setSleepMode(state == P_LIGHT ? WIFI_LIGHT_SLEEP : WIFI_MODEM_SLEEP, listenInterval);
+  }
+  this->state = state;
+}
+
+/**
+ * @brief Selects the power state and sleeps while idle. Called at the end of loop().
+ *
+ * @param busy true while a cycle, the motor or a log transfer is in progress.
+ * @param idleTime Time in ms until the next task deadline.
+ */
+void Power::update(boolean busy, unsigned long idleTime) {
+  if (busy) {
+    enter(P_ACTIVE);
+    return;
+  }
+  enter(POWER_IDLE_MODE);
+  if (idleTime > POWER_MAX_LATENCY)
+    idleTime = POWER_MAX_LATENCY;
+  if (idleTime > 0)
+    delay(idleTime);
+}
+
+unsigned Power::getState() {
+  return state;
+}
+
+/**
+ * @brief Time spent in a state in ms, current period included.
+ */
+unsigned long Power::getTime(unsigned state) {
+  unsigned long t = time[state];
+  if (state == this->state)
+    t += millis() - since;
+  return t;
+}
+
+/**
+ * @brief Number of transitions back to the active state.
+ */
+unsigned Power::getWakeCount() {
+  return wakeCount;
+}
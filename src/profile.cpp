@@ -0,0 +1,90 @@
+/**
+ * @file profile.cpp
+ * @brief Fixed-bucket latency histograms of the main loop sections and of the task lateness.
+ *
+ * Recording a value costs a count-leading-zeros, an increment and a comparison, so the
+ * instrumentation can stay enabled. Percentiles are derived from the power-of-two buckets and
+ * are therefore upper bounds, within a factor of two; the maximum and the mean are exact.
+ */
+#include "profile.h"
+
+Profiler profiler;
+
+static const char *const sectionNames[PROFILE_SECTIONS] = {
+  "loop", "network", "ota", "mqtt", "schedule", "relay", "logs", "timerLate", "publish"
+};
+
+Profiler::Profiler() {
+  reset();
+}
+
+/**
+ * @brief Adds a duration in µs to the histogram of a section.
+ */
+void Profiler::record(unsigned section, uint32_t us) {
+  Histogram &h = histograms[section];
+  unsigned bucket = us == 0 ? 0 : 31 - __builtin_clz(us);
+  if (bucket >= PROFILE_BUCKETS)
+    bucket = PROFILE_BUCKETS - 1;
+  h.buckets[bucket]++;
+  h.count++;
+  h.total += us;
+  if (us > h.max)
+    h.max = us;
+}
+
+uint32_t Profiler::getCount(unsigned section) {
+  return histograms[section].count;
+}
+
+uint32_t Profiler::getMax(unsigned section) {
+  return histograms[section].max;
+}
+
+uint32_t Profiler::getMean(unsigned section) {
+  Histogram &h = histograms[section];
+  return h.count ? h.total / h.count : 0;
+}
+
+/**
+ * @brief Upper bound in µs of the bucket reaching 99 % of the values (at most the maximum).
+ */
+uint32_t Profiler::getP99(unsigned section) {
+  Histogram &h = histograms[section];
+  uint32_t target = h.count - h.count / 100;
+  uint32_t sum = 0;
+  for (unsigned i = 0; i < PROFILE_BUCKETS; i++) {
+    sum += h.buckets[i];
+    if (sum >= target && sum > 0) {
+      uint32_t bound = (2UL << i) - 1;
+      return bound < h.max ? bound : h.max;
+    }
+  }
+  return h.max;
+}
+
+/**
+ * @brief Writes "name:n=..;mean=..us;p99=..us;max=..us;h=b0,b1,..." for a section.
+ *
+ * @return Length of the text.
+ */
+int Profiler::format(unsigned section, char *buffer, unsigned size) {
+  Histogram &h = histograms[section];
+  int n = snprintf(buffer, size, "%s:n=%lu;mean=%luus;p99=%luus;max=%luus;h=",
+    sectionNames[section],
+    (unsigned long)h.count,
+    (unsigned long)getMean(section),
+    (unsigned long)getP99(section),
+    (unsigned long)h.max);
+  // Classes jusqu'à la dernière non vide
+  int last = PROFILE_BUCKETS - 1;
+  while (last > 0 && h.buckets[last] == 0)
+    last--;
+  for (int i = 0; i <= last && n < (int)size; i++)
+    n += snprintf(buffer + n, size - n, i ? ",%lu" : "%lu", (unsigned long)h.buckets[i]);
+  return n;
+}
+
+void Profiler::reset() {
+  memset(histograms, 0, sizeof(histograms));
+}
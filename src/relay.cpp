@@ -0,0 +1,116 @@
+/**
+ * @file relay.cpp
+ * @brief Non-blocking sequencing of the traction relays.
+ *
+ * The forward and return relays are driven through a small state machine advanced by
+ * update() from loop(). A direction change always goes through an off state for
+ * RELAY_DEAD_TIME ms, and a direction is held at least RELAY_MIN_ON_TIME ms before it can be
+ * reversed. Only the latest command is kept, so bursts of commands are merged.
+ * Relays are active low.
+ */
+#include "relay.h"
+
+Relay::Relay() {
+  pinForward = -1;
+  pinReturn = -1;
+  state = R_OFF;
+  request = R_OFF;
+  since = 0;
+}
+
+/**
+ * @brief Configures the relay outputs and switches the motor off.
+ *
+ * @param pinForward GPIO of the forward relay.
+ * @param pinReturn GPIO of the return relay.
+ */
+void Relay::begin(int pinForward, int pinReturn) {
+  this->pinForward = pinForward;
+  this->pinReturn = pinReturn;
+  pinMode(pinForward, OUTPUT);
+  pinMode(pinReturn, OUTPUT);
+  output(R_OFF);
+  state = R_OFF;
+  request = R_OFF;
+  // Le temps mort est considéré comme écoulé au démarrage
+  since = millis() - RELAY_DEAD_TIME;
+}
+
+/**
+ * @brief Drives the outputs. Both relays are released before one is energised.
+ */
+void Relay::output(unsigned cmd) {
+  digitalWrite(pinForward, HIGH);
+  digitalWrite(pinReturn, HIGH);
+  if (cmd == R_FORWARD)
+    digitalWrite(pinForward, LOW);
+  else if (cmd == R_RETURN)
+    digitalWrite(pinReturn, LOW);
+}
+
+/**
+ * @brief Requests a new motor state (R_OFF, R_FORWARD or R_RETURN).
+ *
+ * The request replaces any pending one. Switching off is applied immediately, the other
+ * commands are applied by update().
+ *
+ * @param cmd The requested state.
+ */
+void Relay::command(unsigned cmd) {
+  request = cmd;
+  if (cmd == R_OFF && (state == R_FORWARD || state == R_RETURN)) {
+    output(R_OFF);
+    state = R_SETTLE;
+    since = millis();
+  }
+  update();
+}
+
+/**
+ * @brief Advances the state machine. Must be called on every pass of loop().
+ */
+void Relay::update() {
+  unsigned long now = millis();
+  switch (state) {
+  case R_OFF:
+    if (request != R_OFF) {
+      // Moteur coupé depuis moins que le temps mort : attendre
+      if (now - since < RELAY_DEAD_TIME) {
+        state = R_SETTLE;
+        break;
+      }
+      output(request);
+      state = request;
+      since = now;
+    }
+    break;
+  case R_FORWARD:
+  case R_RETURN:
+    if (request != state && now - since >= RELAY_MIN_ON_TIME) {
+      output(R_OFF);
+      state = R_SETTLE;
+      since = now;
+    }
+    break;
+  case R_SETTLE:
+    if (request == R_OFF) {
+      // Arrêt demandé pendant le temps mort : since garde l'instant de coupure
+      state = R_OFF;
+    }
+    else if (now - since >= RELAY_DEAD_TIME) {
+      // Appliquer la dernière commande reçue pendant le temps mort
+      output(request);
+      state = request;
+      since = now;
+    }
+    break;
+  }
+}
+
+unsigned Relay::getState() {
+  return state;
+}
+
+unsigned Relay::getRequest() {
+  return request;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file status.cpp
+ * @brief Single retained status frame, published on change.
+ *
+ * The cycle progress, the current leg and the schedule state are formatted in one frame that
+ * is published as a retained message through the outbound queue, so that an application gets
+ * it from the broker as soon as it subscribes. The frame is sent again only when its text
+ * changes, and at most once per STATUS_MIN_INTERVAL ms. The current leg is given by its start
+ * time and duration, which do not change while it runs.
+ */
+#include "status.h"
+#include "wallClock.h"
+
+StatusPublisher::StatusPublisher() {
+  outbox = NULL;
+  topic = NULL;
+  published[0] = 0;
+  lastPublish = 0;
+  lastCheck = 0;
+  publishCount = 0;
+}
+
+/**
+ * @brief Sets the outbound queue and the topic of the frame.
+ */
+void StatusPublisher::begin(Outbox &outbox, const char *topic) {
+  this->outbox = &outbox;
+  this->topic = topic;
+}
+
+/**
+ * @brief Formats a status frame (see status.h).
+ *
+ * @return Number of characters written.
+ */
+int StatusPublisher::format(const StatusFrame *frame, char *buffer, unsigned size) {
+  DateTime date;
+  int n = snprintf(buffer, size, "cycle=%u/%u;t=%u/%u;run=%u;leg=%s;p=%lu/%u;sch=",
+    frame->cycle, frame->cycles, frame->elapsed, frame->total, frame->run,
+    frame->run == ST_STOPPED ? "-" : frame->forward ? "AV" : "AR",
+    (unsigned long)frame->legStart, frame->legTotal);
+  if (frame->scheduled != 0) {
+    epochToDateTime(frame->scheduled, &date);
+    n += snprintf(buffer + n, size - n, "%02d:%02d", date.hour, date.minute);
+  }
+  else
+    n += snprintf(buffer + n, size - n, "-");
+  if (frame->nextRun != 0) {
+    epochToDateTime(frame->nextRun, &date);
+    n += snprintf(buffer + n, size - n, ";next=%02d/%02d %02d:%02d",
+      date.day, date.month, date.hour, date.minute);
+  }
+  else
+    n += snprintf(buffer + n, size - n, ";next=-");
+  return n;
+}
+
+/**
+ * @brief true every STATUS_CHECK_PERIOD ms once the minimal interval since the last
+ * publication has elapsed: the caller then reads the state and calls update().
+ */
+boolean StatusPublisher::due() {
+  unsigned long now = millis();
+  if (now - lastCheck < STATUS_CHECK_PERIOD)
+    return false;
+  if (publishCount > 0 && now - lastPublish < STATUS_MIN_INTERVAL)
+    return false;
+  lastCheck = now;
+  return true;
+}
+
+/**
+ * @brief Publishes the frame if it differs from the last one published.
+ *
+ * @return true if the frame was published.
+ */
+boolean StatusPublisher::update(const StatusFrame *frame) {
+  char text[STATUS_TEXT_MAX];
+  format(frame, text, sizeof(text));
+  if (publishCount > 0 && strcmp(text, published) == 0)
+    return false;
+  return send(text);
+}
+
+/**
+ * @brief Publishes the frame unconditionally (explicit status request).
+ */
+boolean StatusPublisher::publish(const StatusFrame *frame) {
+  char text[STATUS_TEXT_MAX];
+  format(frame, text, sizeof(text));
+  return send(text);
+}
+
+/**
+ * @brief Queues a retained frame. A frame that could not be queued is not recorded, so that
+ * it is tried again at the next check.
+ */
+boolean StatusPublisher::send(const char *text) {
+  if (outbox == NULL || !outbox->post(topic, text, OB_STATE | OB_RETAIN))
+    return false;
+  strcpy(published, text);
+  lastPublish = millis();
+  publishCount++;
+  return true;
+}
+
+/**
+ * @brief Number of frames published since boot.
+ */
+unsigned StatusPublisher::getPublishCount() {
+  return publishCount;
+}
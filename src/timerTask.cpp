@@ -4,13 +4,35 @@
  *
  * This file implements a simple task scheduler that manages tasks with timing functionality.
  * Each task can be either a one-shot (monostable) or a repeating timer. Tasks are stored in a
- * fixed-size array (tabTask) and are executed based on their timing parameters.
+ * fixed-size array (tabTask) and never allocated. A task is referred to by a task_id holding
+ * its slot index and the generation of the slot, bumped at each creation: every public method
+ * ignores an identifier whose task has been deleted, even if the slot was reused. Ready tasks are also kept in a binary min-heap ordered by their
+ * absolute deadline, so that a call to schedule() only has to look at the top of the heap.
+ * Deadlines are absolute millis() values: all intervals are expressed in milliseconds and
+ * comparisons are done on signed differences, which keeps them valid across the 49-day
+ * wraparound of millis() (intervals must stay below 2^31 ms).
+ *
+ * Expirations are detected by tic(), driven by a hardware timer (Ticker) as well as by
+ * schedule(). tic() only moves expired tasks into a deferred-work queue; the callbacks are
+ * executed by schedule() from loop(). Every expiration missed while loop() was blocked is
+ * queued and applied, so timings do not depend on the duration of network calls.
+ * The lateness of each execution relative to its deadline is recorded by the profiler.
  */
 #include "timerTask.h"
+#include "profile.h"
 
 Task tabTask[MAX_TASK];
-Task tabLastStatusTask[MAX_TASK];
-const char* textStatus[4] = {"N_CREE", "CREE", "PRET", "SUSP"};
+// Tas des tâches prêtes, trié par échéance croissante
+int heap[MAX_TASK];
+int heapSize = 0;
+// File des exécutions différées (identifiants), alimentée par tic() et vidée par schedule()
+volatile task_id readyQueue[READY_QUEUE_LEN];
+// Échéance de chaque exécution différée, pour mesurer son retard
+volatile unsigned readyDue[READY_QUEUE_LEN];
+volatile unsigned readyHead = 0;
+volatile unsigned readyTail = 0;
+volatile unsigned readyOverflow = 0;
+const char* textStatus[5] = {"N_CREE", "CREE", "PRET", "SUSP", "EXEC"};
 
 /**
  * @brief Default constructor.
@@ -18,65 +40,276 @@ const char* textStatus[4] = {"N_CREE", "CREE", "PRET", "SUSP"};
  * Initializes a Task object by setting its status to N_CREE and initializing timing parameters (currentTime and stopTime) to 0.
  */
 Task::Task() {
-  // fonc = 0;
+  fonc = NULL;
+  context = NULL;
+  generation = 0;
   status = N_CREE;
+  lastStatus = CREE;
   currentTime = 0;
   startTime = 0;
+  deadline = 0;
+  heapIndex = -1;
+  pending = 0;
+}
+
+/**
+ * @brief Compares the deadlines of two tasks.
+ *
+ * The difference is evaluated as a signed value so that the comparison stays
+ * correct when millis() wraps around.
+ *
+ * @return true if task a expires before task b.
+ */
+boolean Task::before(int a, int b) {
+  return (int)(tabTask[a].deadline - tabTask[b].deadline) < 0;
+}
+
+void Task::heapSwap(int i, int j) {
+  int t = heap[i];
+  heap[i] = heap[j];
+  heap[j] = t;
+  tabTask[heap[i]].heapIndex = i;
+  tabTask[heap[j]].heapIndex = j;
+}
+
+void Task::siftUp(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!before(heap[i], heap[parent]))
+      break;
+    heapSwap(i, parent);
+    i = parent;
+  }
+}
+
+void Task::siftDown(int i) {
+  for (;;) {
+    int left = 2 * i + 1;
+    int right = left + 1;
+    int min = i;
+    if (left < heapSize && before(heap[left], heap[min]))
+      min = left;
+    if (right < heapSize && before(heap[right], heap[min]))
+      min = right;
+    if (min == i)
+      break;
+    heapSwap(i, min);
+    i = min;
+  }
+}
+
+/**
+ * @brief Inserts a task in the deadline heap, or reorders it if already present.
+ */
+void Task::heapPush(int taskId) {
+  if (tabTask[taskId].heapIndex >= 0) {
+    heapUpdate(taskId);
+    return;
+  }
+  heap[heapSize] = taskId;
+  tabTask[taskId].heapIndex = heapSize;
+  siftUp(heapSize++);
+}
+
+/**
+ * @brief Removes a task from the deadline heap (no effect if absent).
+ */
+void Task::heapRemove(int taskId) {
+  int i = tabTask[taskId].heapIndex;
+  if (i < 0)
+    return;
+  tabTask[taskId].heapIndex = -1;
+  if (--heapSize == i)
+    return;
+  heap[i] = heap[heapSize];
+  tabTask[heap[i]].heapIndex = i;
+  siftUp(i);
+  siftDown(tabTask[heap[i]].heapIndex);
+}
+
+/**
+ * @brief Restores the heap order after the deadline of a task has changed.
+ */
+void Task::heapUpdate(int taskId) {
+  int i = tabTask[taskId].heapIndex;
+  if (i < 0)
+    return;
+  siftUp(i);
+  siftDown(tabTask[taskId].heapIndex);
+}
+
+/**
+ * @brief Time elapsed since the task was (re)armed.
+ *
+ * For a task in the heap it is derived from its deadline, otherwise the
+ * value memorised in currentTime is returned.
+ */
+unsigned Task::elapsed(int taskId) {
+  Task& t = tabTask[taskId];
+  if (t.heapIndex < 0)
+    return t.currentTime;
+  return t.startTime - (t.deadline - millis());
+}
+
+/**
+ * @brief Slot of a task identifier.
+ *
+ * @return The index in tabTask, -1 if the identifier is invalid or its task was deleted.
+ */
+int Task::slot(task_id id) {
+  if (id < 0)
+    return -1;
+  int taskId = id & ((1 << TASK_INDEX_BITS) - 1);
+  if (taskId >= MAX_TASK || tabTask[taskId].status == N_CREE
+      || tabTask[taskId].generation != ((unsigned)id >> TASK_INDEX_BITS))
+    return -1;
+  return taskId;
+}
+
+/**
+ * @brief Identifier of the task currently held by a slot.
+ */
+task_id Task::handle(int taskId) {
+  return (task_id)(tabTask[taskId].generation << TASK_INDEX_BITS | taskId);
 }
 
 /**
  * @brief Creates a new task.
  *
- * This function allocates a new Task with the provided function pointer and stop time,
- * then searches for a free entry in the task table (tabTask) to store the new task.
+ * This function searches for a free entry in the task table (tabTask) and builds the task
+ * there with the provided function pointer, context and stop time, without dynamic allocation.
+ * The generation of the slot is incremented, which invalidates the identifiers of the tasks
+ * previously held by it.
  *
  * @param fonc Pointer to the function that defines the task's behavior.
- * @param stopTime The time interval (in ticks or seconds) after which the task should be executed.
+ * @param context Pointer passed to fonc at each execution.
+ * @param stopTime The time interval (in milliseconds) after which the task should be executed.
  * @param isTimer Boolean flag indicating whether the task is a recurring timer (true) or a one-shot task (false).
- * @return The index of the task in tabTask if successfully created; returns -1 if no free slot is found.
+ * @return The identifier of the task if successfully created; returns TASK_NONE if no free slot is found.
  */
-int Task::t_creer(void (*fonc)(void),unsigned stopTime, boolean isTimer) {
-  // Créer une tâche
-  Task* task = new Task(fonc,stopTime);
+task_id Task::t_creer(TaskFunction fonc, void *context, unsigned stopTime, boolean isTimer) {
   // Chercher un emplacement libre dans le tableau de tâches
   for (int taskId = 0; taskId < MAX_TASK; taskId++) {
     if (tabTask[taskId].status == N_CREE) {
-      // Y copier la tâche 
-      tabTask[taskId] = *task;
+      // Y créer la tâche, la génération 0 n'est jamais utilisée
+      unsigned generation = tabTask[taskId].generation % TASK_GENERATION_MAX + 1;
+      tabTask[taskId] = Task(fonc, context, stopTime);
+      tabTask[taskId].generation = generation;
       tabTask[taskId].timerTask = isTimer;
-      return taskId;
+      return handle(taskId);
     }
   }
-  return -1;
+  return TASK_NONE;
 }
+/**
+ * @brief Detects expired tasks and queues their execution.
+ *
+ * Called by the hardware timer (Ticker) every TIMER_TIC ms and by schedule(). Each task of
+ * the heap whose deadline has been reached is appended to the deferred-work queue. A recurring
+ * task is immediately re-armed from its previous deadline: if loop() is blocked for several
+ * periods, one execution per missed period is queued. No callback is executed here.
+ */
+void Task::tic() {
+  unsigned now = millis();
+  while (heapSize > 0 && (int)(now - tabTask[heap[0]].deadline) >= 0) {
+    if (readyTail - readyHead >= READY_QUEUE_LEN) {
+      // File pleine : l'échéance sera reprise au prochain tic
+      readyOverflow++;
+      return;
+    }
+    int taskId = heap[0];
+    Task& t = tabTask[taskId];
+    readyQueue[readyTail % READY_QUEUE_LEN] = handle(taskId);
+    readyDue[readyTail % READY_QUEUE_LEN] = t.deadline;
+    readyTail++;
+    t.pending++;
+    if (t.timerTask) {
+      t.deadline += t.startTime;
+      heapUpdate(taskId);
+    }
+    else {
+      heapRemove(taskId);
+      t.currentTime = t.startTime;
+    }
+  }
+}
+
 /**
  * @brief Schedules tasks for execution.
  *
- * This function iterates through all tasks in the task table and checks if they are in the PRET (ready) state.
- * For each ready task, it increments the currentTime count. When currentTime matches stopTime,
- * the associated function (fonc) is executed. Post execution, the task status is updated depending on
- * whether it is a timer task (recurring) or a one-shot task.
+ * This function executes, in order, the tasks queued by tic(). It is called on every pass of
+ * loop(); when nothing has expired it only examines the top of the heap. Entries belonging to
+ * a task stopped, suspended or deleted in the meantime are discarded. Post execution, the task status
+ * is updated depending on whether it is a timer task (recurring, already re-armed by tic())
+ * or a one-shot task.
  */
 void Task::schedule() {
-  for (int taskId = 0; taskId < MAX_TASK; taskId++) {
-      // printStatus(taskId);
-    if (tabTask[taskId].status == PRET) {
-      tabTask[taskId].currentTime++;
-      if (tabTask[taskId].currentTime == tabTask[taskId].startTime) {
-        tabTask[taskId].status = EXEC;
-        tabTask[taskId].fonc();
-      }
-      if (tabTask[taskId].status == EXEC) {
-        if (!tabTask[taskId].timerTask)
-          tabTask[taskId].status = CREE;
-        else {
-          tabTask[taskId].status = PRET;
-          tabTask[taskId].currentTime = 0;
-        }
+  noInterrupts();
+  tic();
+  interrupts();
+  while (readyHead != readyTail) {
+    noInterrupts();
+    task_id id = readyQueue[readyHead % READY_QUEUE_LEN];
+    unsigned due = readyDue[readyHead % READY_QUEUE_LEN];
+    readyHead++;
+    int taskId = slot(id);
+    boolean run = taskId >= 0 && tabTask[taskId].pending > 0 && tabTask[taskId].status == PRET;
+    if (run)
+      tabTask[taskId].pending--;
+    interrupts();
+    if (!run)
+      continue;
+    // Retard sur l'échéance (résolution 1 ms), saturé au-delà de 71 mn en µs
+    uint32_t late = millis() - due;
+    profiler.record(PS_TIMER_LATE, late > UINT32_MAX / 1000 ? UINT32_MAX : late * 1000);
+    tabTask[taskId].status = EXEC;
+    tabTask[taskId].fonc(tabTask[taskId].context);
+    // La fonction a pu arrêter, relancer ou supprimer la tâche
+    if (slot(id) == taskId && tabTask[taskId].status == EXEC) {
+      if (!tabTask[taskId].timerTask) {
+        tabTask[taskId].status = CREE;
+        tabTask[taskId].currentTime = 0;
       }
+      else
+        tabTask[taskId].status = PRET;
     }
   }
 }
+
+/**
+ * @brief Time in ms until the earliest deadline, used to sleep until the next task.
+ *
+ * @return 0 if executions are pending, (unsigned)-1 if no task is armed.
+ */
+unsigned Task::idleTime() {
+  unsigned t = (unsigned)-1;
+  noInterrupts();
+  if (readyHead != readyTail)
+    t = 0;
+  else if (heapSize > 0) {
+    int remaining = tabTask[heap[0]].deadline - millis();
+    t = remaining > 0 ? remaining : 0;
+  }
+  interrupts();
+  return t;
+}
+
+/**
+ * @brief Number of expirations postponed because the deferred-work queue was full.
+ */
+unsigned Task::getQueueOverflow() {
+  return readyOverflow;
+}
+
+/**
+ * @brief Number of created tasks (slots in use).
+ */
+unsigned Task::getTaskCount() {
+  unsigned count = 0;
+  for (int taskId = 0; taskId < MAX_TASK; taskId++)
+    count += tabTask[taskId].status != N_CREE;
+  return count;
+}
 /**
  * @brief Prints the status of all tasks.
  *
@@ -84,26 +317,34 @@ void Task::schedule() {
  */
 void  Task::printStatusAll() {
   for (int taskId = 0; taskId < MAX_TASK; taskId++)
-    printStatus(taskId);
+    printSlot(taskId);
+}
+void Task::printSlot(int taskId) {
+  Serial.printf("task=%d, status=%s, currentTime=%2d, stopTime=%2d\n",
+    taskId, textStatus[tabTask[taskId].status], elapsed(taskId), tabTask[taskId].startTime);
 }
 /**
  * @brief Prints the status of a specific task.
  *
- * Prints detailed information (task ID, status, currentTime, stopTime) for the task identified by taskId.
+ * Prints detailed information (task ID, status, currentTime, stopTime) for the task identified by id.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void  Task::printStatus(int taskId) {
-  Serial.printf("task=%d, status=%s, currentTime=%2d, stopTime=%2d\n",
-    taskId, textStatus[tabTask[taskId].status], tabTask[taskId].currentTime, tabTask[taskId].startTime);
+void  Task::printStatus(task_id id) {
+  int taskId = slot(id);
+  if (taskId >= 0)
+    printSlot(taskId);
 }
 /**
  * @brief Retrieves the current status of a task.
  *
- * @param taskId The index of the task in the task table.
- * @return The status of the specified task.
+ * @param id The identifier of the task.
+ * @return The status of the specified task, N_CREE if it does not exist anymore.
  */
-int Task::getStatus(int taskId) {
+int Task::getStatus(task_id id) {
+  int taskId = slot(id);
+  if (taskId < 0)
+    return N_CREE;
   return tabTask[taskId].status;
 }
 /**
@@ -112,17 +353,23 @@ int Task::getStatus(int taskId) {
  * Sets the task status to PRET (ready) and resets its currentTime counter.
  * For timer tasks (recurring), the associated function (fonc) is executed immediately.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void Task::t_start(int taskId) {
-  // Serial.println(taskId);
-  if (taskId == -1)
+void Task::t_start(task_id id) {
+  // Serial.println(id);
+  int taskId = slot(id);
+  if (taskId < 0)
     return;
   tabTask[taskId].status = PRET;
   // if (tabTask[itask].stopTime == tabTask[itask].currentTime)
   tabTask[taskId].currentTime = 0;
+  noInterrupts();
+  tabTask[taskId].pending = 0;
+  tabTask[taskId].deadline = millis() + tabTask[taskId].startTime;
+  heapPush(taskId);
+  interrupts();
   if (tabTask[taskId].timerTask) {
-    tabTask[taskId].fonc();
+    tabTask[taskId].fonc(tabTask[taskId].context);
   }
 }
 /**
@@ -130,65 +377,91 @@ void Task::t_start(int taskId) {
  *
  * Resets the task by setting its status to CREE and currentTime to 0.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void Task::t_stop(int taskId) {
-  if (taskId == -1)
+void Task::t_stop(task_id id) {
+  int taskId = slot(id);
+  if (taskId < 0)
     return;
+  noInterrupts();
+  heapRemove(taskId);
+  tabTask[taskId].pending = 0;
   tabTask[taskId].status = CREE;
   tabTask[taskId].currentTime = 0;
+  interrupts();
 }
 /**
  * @brief Updates the interval (stopTime) for a task.
  *
  * Sets the stopTime parameter that determines how long the task should wait before executing.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  * @param interval The time interval after which the task should execute.
  */
-void Task::setInterval(int taskId, unsigned interval) {
-  tabTask[taskId].startTime = interval;
+void Task::setInterval(task_id id, unsigned interval) {
+  setStartTime(id, interval);
 }
 /**
  * @brief Deletes a task.
  *
  * Marks the task as not created (N_CREE) in the task table, effectively removing it from scheduling.
+ * Its identifier is rejected from then on.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void Task::t_delete(int taskId) {
-  // Serial.println(itask);
-  if (taskId == -1)
+void Task::t_delete(task_id id) {
+  // Serial.println(id);
+  int taskId = slot(id);
+  if (taskId < 0)
     return;
+  noInterrupts();
+  heapRemove(taskId);
+  tabTask[taskId].pending = 0;
   tabTask[taskId].status = N_CREE;
+  interrupts();
 }
 /**
  * @brief Retrieves the current time counter for a task.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  * @return The currentTime value of the task.
  */
-unsigned Task::getCurrentTime(int taskId) {
-  return tabTask[taskId].currentTime;
+unsigned Task::getCurrentTime(task_id id) {
+  int taskId = slot(id);
+  if (taskId < 0)
+    return 0;
+  return elapsed(taskId);
 }
 /**
  * @brief Sets the current time counter for a task.
  *
  * Updates the currentTime value used to track the elapsed time for the task.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  * @param time The new count value to set for currentTime.
  */
-void Task::setCurrentTime(int taskId , unsigned time) {
+void Task::setCurrentTime(task_id id, unsigned time) {
+  int taskId = slot(id);
+  if (taskId < 0)
+    return;
+  noInterrupts();
   tabTask[taskId].currentTime = time;
+  if (tabTask[taskId].heapIndex >= 0) {
+    tabTask[taskId].deadline = millis() - time + tabTask[taskId].startTime;
+    heapUpdate(taskId);
+  }
+  interrupts();
 }
 /**
  * @brief Retrieves the stop time (interval) of a task.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  * @return The stopTime value of the task.
  */
-unsigned Task::getStartTime(int taskId) {
+unsigned Task::getStartTime(task_id id) {
+  int taskId = slot(id);
+  if (taskId < 0)
+    return 0;
   return tabTask[taskId].startTime;
 }
 
@@ -197,34 +470,64 @@ unsigned Task::getStartTime(int taskId) {
  *
  * Updates the stopTime value, which determines when the task should be executed.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  * @param time The new stopTime value to set.
  */
-void Task::setStartTime(int taskId, unsigned time) {
-  tabTask[taskId].startTime = time;
+void Task::setStartTime(task_id id, unsigned time) {
+  int taskId = slot(id);
+  if (taskId < 0)
+    return;
+  // L'échéance d'une tâche armée est recalculée depuis son origine
+  noInterrupts();
+  if (tabTask[taskId].heapIndex >= 0) {
+    tabTask[taskId].deadline += time - tabTask[taskId].startTime;
+    tabTask[taskId].startTime = time;
+    heapUpdate(taskId);
+  }
+  else
+    tabTask[taskId].startTime = time;
+  interrupts();
 }
 
 /**
  * @brief Supspend a task.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void Task::t_suspend(int taskId) {
-  // Serial.println(itask);
-  if (taskId == -1)
+void Task::t_suspend(task_id id) {
+  // Serial.println(id);
+  int taskId = slot(id);
+  if (taskId < 0)
     return;
   // if (tabTask[taskId].status == EXEC)
-  tabLastStatusTask[taskId].status = tabTask[taskId].status;  
+  if (tabTask[taskId].status == SUSP)
+    return;
+  tabTask[taskId].lastStatus = tabTask[taskId].status;
+  // Mémoriser le temps écoulé et sortir la tâche du tas
+  noInterrupts();
+  tabTask[taskId].currentTime = elapsed(taskId);
+  heapRemove(taskId);
+  tabTask[taskId].pending = 0;
   tabTask[taskId].status = SUSP;
+  interrupts();
 }
 /**
  * @brief Resume a task.
  *
- * @param taskId The index of the task in the task table.
+ * @param id The identifier of the task.
  */
-void Task::t_resume(int taskId) {
-  // Serial.println(itask);
-  if (taskId == -1)
+void Task::t_resume(task_id id) {
+  // Serial.println(id);
+  int taskId = slot(id);
+  if (taskId < 0)
     return;
-  tabTask[taskId].status = tabLastStatusTask[taskId].status;  
+  if (tabTask[taskId].status != SUSP)
+    return;
+  tabTask[taskId].status = tabTask[taskId].lastStatus;
+  if (tabTask[taskId].status == PRET) {
+    noInterrupts();
+    tabTask[taskId].deadline = millis() - tabTask[taskId].currentTime + tabTask[taskId].startTime;
+    heapPush(taskId);
+    interrupts();
+  }
 }
@@ -0,0 +1,265 @@
+/**
+ * @file wallClock.cpp
+ * @brief Wall clock synchronised by NTP and derived from millis() between syncs.
+ *
+ * The clock keeps a (UTC epoch, millis) reference refreshed by SNTP on its own schedule. The
+ * exchange never waits in loop(): the request is sent by one call to update() and the reply read
+ * by a later one. The server transmit time, fraction included, is assigned to the middle of the
+ * round trip, which gives a millisecond reference. Local
+ * time applies the European summer time rules. The broken-down local time is cached until the
+ * second changes, and timestamps are formatted into caller-provided buffers.
+ * Sync metrics: interval between the last two syncs, offset correction applied at the last
+ * sync and the resulting drift of the local oscillator in ppm.
+ */
+#include <ESP8266WiFi.h>
+#include "wallClock.h"
+
+/**
+ * @brief Converts a UTC epoch into the local epoch (CET/CEST).
+ */
+uint32_t utcToLocal(uint32_t utc) {
+  // Année UTC approximative suffisante : les changements d'heure ont lieu loin du 1er janvier
+  long year = 1970 + utc / 31556952L;
+  if (utc >= dstStart(year) && utc < dstEnd(year))
+    return utc + TZ_DST_OFFSET;
+  return utc + TZ_STD_OFFSET;
+}
+
+/**
+ * @brief UTC instant at which the local clock first reaches a local epoch.
+ *
+ * A local time skipped by the change to summer time gives the instant of the change; a local
+ * time repeated by the change to winter time gives its first (summer time) occurrence.
+ */
+uint32_t localToUtc(uint32_t local) {
+  long year = 1970 + local / 31556952L;
+  uint32_t summer = local - TZ_DST_OFFSET;
+  if (summer >= dstStart(year) && summer < dstEnd(year))
+    return summer;
+  uint32_t winter = local - TZ_STD_OFFSET;
+  // Heure sautée au passage à l'heure d'été
+  if (winter >= dstStart(year) && winter < dstEnd(year))
+    return dstStart(year);
+  return winter;
+}
+
+/**
+ * @brief Converts an epoch (seconds) into a broken-down date, without gmtime().
+ */
+void epochToDateTime(uint32_t epoch, DateTime *dateTime) {
+  long days = epoch / 86400;
+  unsigned long seconds = epoch % 86400;
+  dateTime->hour = seconds / 3600;
+  dateTime->minute = (seconds / 60) % 60;
+  dateTime->second = seconds % 60;
+  dateTime->weekday = weekdayFromDays(days);
+  // Algorithme civil_from_days de H. Hinnant
+  days += 719468;
+  long era = days / 146097;
+  unsigned long doe = days - era * 146097;
+  unsigned long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned long mp = (5 * doy + 2) / 153;
+  dateTime->day = doy - (153 * mp + 2) / 5 + 1;
+  dateTime->month = mp < 10 ? mp + 3 : mp - 9;
+  dateTime->year = yoe + era * 400 + (dateTime->month <= 2);
+}
+
+/**
+ * @brief Formats a date as "dd/mm/yyyy hh:mm:ss".
+ *
+ * @return Length of the string.
+ */
+int formatDateTime(const DateTime *dateTime, char *buffer, unsigned size) {
+  return snprintf(buffer, size, "%02d/%02d/%4d %02d:%02d:%02d",
+    dateTime->day, dateTime->month, dateTime->year,
+    dateTime->hour, dateTime->minute, dateTime->second);
+}
+
+WallClock::WallClock() {
+  udp = NULL;
+  server = NULL;
+  resolved = false;
+  pending = false;
+  sentAt = 0;
+  failures = 0;
+  synced = false;
+  baseEpoch = 0;
+  baseMillis = 0;
+  lastAttempt = 0;
+  cachedEpoch = 1;
+  syncInterval = 0;
+  lastCorrection = 0;
+  drift = 0;
+}
+
+/**
+ * @brief Opens the UDP socket and waits for the first sync (boot only).
+ *
+ * @param server Host name of the NTP server.
+ */
+void WallClock::begin(WiFiUDP *udp, const char *server) {
+  this->udp = udp;
+  this->server = server;
+  udp->begin(CLOCK_NTP_LOCAL_PORT);
+  lastAttempt = millis() - CLOCK_RETRY_INTERVAL;
+  update();
+  // Premiers logs datés : attente bornée de la réponse
+  while (pending) {
+    delay(10);
+    update();
+  }
+}
+
+/**
+ * @brief Sends an SNTP request when the sync (or retry) interval has elapsed, then reads the reply.
+ *
+ * Called from loop(). Does nothing while WiFi is down; a request without reply after
+ * CLOCK_NTP_TIMEOUT ms is dropped and tried again after CLOCK_RETRY_INTERVAL ms.
+ */
+void WallClock::update() {
+  unsigned long now = millis();
+  if (pending) {
+    if (receive() || now - sentAt < CLOCK_NTP_TIMEOUT)
+      return;
+    pending = false;
+    // Serveur du pool peut-être hors service : nouvelle résolution
+    if (++failures >= CLOCK_NTP_MAX_FAILURES) {
+      resolved = false;
+      failures = 0;
+    }
+    return;
+  }
+  unsigned long interval = (synced && failures == 0) ? CLOCK_SYNC_INTERVAL : CLOCK_RETRY_INTERVAL;
+  if (now - lastAttempt < interval || WiFi.status() != WL_CONNECTED)
+    return;
+  lastAttempt = now;
+  if (!request())
+    failures++;
+}
+
+/**
+ * @brief Sends a client request to the server, resolving its name first if needed.
+ */
+boolean WallClock::request() {
+  if (!resolved) {
+    // Résolution DNS bloquante : au boot ou après des échecs répétés
+    resolved = WiFi.hostByName(server, serverIP) == 1;
+    if (!resolved)
+      return false;
+  }
+  // Réponse tardive d'un échange abandonné
+  while (udp->parsePacket() > 0)
+    udp->flush();
+  uint8_t packet[NTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  // LI 3 (non synchronisé), version 4, mode client
+  packet[0] = 0xe3;
+  if (!udp->beginPacket(serverIP, CLOCK_NTP_PORT))
+    return false;
+  udp->write(packet, sizeof(packet));
+  if (!udp->endPacket())
+    return false;
+  sentAt = millis();
+  pending = true;
+  return true;
+}
+
+/**
+ * @brief Reads the server reply, if arrived, and moves the time reference.
+ *
+ * The correction is the difference, in ms, between the server time and the time derived from
+ * millis() at the same instant; the drift relates it to the time since the previous sync.
+ *
+ * @return true if a valid reply has been read.
+ */
+boolean WallClock::receive() {
+  uint8_t packet[NTP_PACKET_SIZE];
+  if (udp->parsePacket() < NTP_PACKET_SIZE)
+    return false;
+  unsigned long now = millis();
+  udp->read(packet, sizeof(packet));
+  // Réponse d'un serveur (mode 4) synchronisé (strate non nulle)
+  if ((packet[0] & 7) != 4 || packet[1] == 0)
+    return false;
+  uint32_t seconds = 0;
+  uint32_t fraction = 0;
+  for (int i = 0; i < 4; i++) {
+    seconds = seconds << 8 | packet[40 + i];
+    fraction = fraction << 8 | packet[44 + i];
+  }
+  uint32_t epoch = seconds - NTP_UNIX_OFFSET;
+  // millis() de la seconde NTP epoch, le serveur répondant au milieu de l'aller-retour
+  unsigned long base = sentAt + (now - sentAt) / 2 - (unsigned long)(((uint64_t)fraction * 1000) >> 32);
+  if (synced) {
+    unsigned long elapsed = base - baseMillis;
+    lastCorrection = (long)(epoch - baseEpoch) * 1000L - (long)elapsed;
+    syncInterval = elapsed;
+    drift = elapsed ? (long)((long long)lastCorrection * 1000000LL / (long long)elapsed) : 0;
+  }
+  baseEpoch = epoch;
+  baseMillis = base;
+  synced = true;
+  pending = false;
+  failures = 0;
+  cachedEpoch = 1;
+  return true;
+}
+
+boolean WallClock::isSynced() {
+  return synced;
+}
+
+/**
+ * @brief Current UTC epoch in seconds.
+ */
+uint32_t WallClock::utc() {
+  return baseEpoch + (millis() - baseMillis) / 1000;
+}
+
+/**
+ * @brief Current local epoch in seconds (CET/CEST).
+ */
+uint32_t WallClock::local() {
+  return utcToLocal(utc());
+}
+
+/**
+ * @brief Current local time, recomputed only when the second has changed.
+ */
+const DateTime *WallClock::now() {
+  uint32_t t = local();
+  if (t != cachedEpoch) {
+    epochToDateTime(t, &cached);
+    cachedEpoch = t;
+  }
+  return &cached;
+}
+
+/**
+ * @brief Formats the current local time as "dd/mm/yyyy hh:mm:ss" into buffer.
+ */
+int WallClock::format(char *buffer, unsigned size) {
+  return formatDateTime(now(), buffer, size);
+}
+
+/**
+ * @brief Time between the last two successful syncs in ms.
+ */
+unsigned long WallClock::getSyncInterval() {
+  return syncInterval;
+}
+
+/**
+ * @brief Offset correction applied at the last sync in ms (positive: clock was late).
+ */
+long WallClock::getLastCorrection() {
+  return lastCorrection;
+}
+
+/**
+ * @brief Drift of the millis() time base measured at the last sync, in ppm.
+ */
+long WallClock::getDrift() {
+  return drift;
+}